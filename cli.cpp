@@ -0,0 +1,380 @@
+#include "cli.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <charconv>
+#include <cmath>
+#include <fstream>
+#include <limits>
+#include <sstream>
+#include <stdexcept>
+#include <thread>
+
+#include "graphic.hpp"
+#include "indexed_trajectory.hpp"
+
+namespace pf {
+
+namespace {
+
+// Sink che scarta i campioni: in streaming restano solo le statistiche
+struct DiscardSink : TrajectorySink {
+  void consume(const TrajectoryChunk &) override {}
+};
+
+// Legge un numero, rifiutando testo residuo
+double toNumber(const std::string &option, const std::string &text) {
+  double value = 0.0;
+  const char *last = text.data() + text.size();
+  auto [ptr, ec] = std::from_chars(text.data(), last, value);
+  if (ec != std::errc() || ptr != last)
+    throw std::invalid_argument("Valore non valido per " + option + ": " +
+                                text);
+  return value;
+}
+
+Method toMethod(const std::string &name) {
+  if (name == "euler")
+    return Method::Euler;
+  if (name == "rk4")
+    return Method::RK4;
+  if (name == "dp")
+    return Method::DormandPrince;
+  if (name == "symplectic")
+    return Method::Symplectic;
+  throw std::invalid_argument("Metodo sconosciuto: " + name);
+}
+
+OutputFormat toFormat(const std::string &name) {
+  if (name == "text")
+    return OutputFormat::Text;
+  if (name == "shortest")
+    return OutputFormat::Shortest;
+  if (name == "binary")
+    return OutputFormat::Binary;
+  if (name == "compressed")
+    return OutputFormat::Compressed;
+  if (name == "indexed")
+    return OutputFormat::Indexed;
+  if (name == "none")
+    return OutputFormat::None;
+  throw std::invalid_argument("Formato sconosciuto: " + name);
+}
+
+// Applica al job l'opzione args[i] e ne consuma gli argomenti; restituisce
+// false se l'opzione non riguarda il job
+bool applyOption(JobOptions &job, const std::vector<std::string> &args,
+                 std::size_t &i) {
+  const std::string &option = args[i];
+  auto next = [&]() -> const std::string & {
+    if (i + 1 >= args.size())
+      throw std::invalid_argument("Argomento mancante per " + option);
+    return args[++i];
+  };
+  auto number = [&] { return toNumber(option, next()); };
+
+  if (option == "--params") {
+    job.A = number();
+    job.B = number();
+    job.C = number();
+    job.D = number();
+    job.parametersSet = true;
+  } else if (option == "--initial") {
+    job.x_0 = number();
+    job.y_0 = number();
+    job.initialSet = true;
+  } else if (option == "--method") {
+    job.method = toMethod(next());
+  } else if (option == "--dt") {
+    job.dt = number();
+  } else if (option == "--duration") {
+    job.duration = number();
+  } else if (option == "--tolerances") {
+    job.absTol = number();
+    job.relTol = number();
+  } else if (option == "--stride") {
+    double stride = number();
+    if (stride < 1 || stride != std::floor(stride))
+      throw std::invalid_argument("--stride deve essere un intero positivo");
+    job.stride = static_cast<std::size_t>(stride);
+  } else if (option == "--format") {
+    job.format = toFormat(next());
+  } else if (option == "--prefix") {
+    job.prefix = next();
+  } else if (option == "--h-tolerance") {
+    job.hTolerance = number();
+  } else if (option == "--no-h") {
+    job.computeH = false;
+  } else if (option == "--no-statistics") {
+    job.statistics = false;
+  } else if (option == "--plot") {
+    job.plot = true;
+  } else {
+    return false;
+  }
+  return true;
+}
+
+// Stessi controlli della modalita' interattiva
+void validate(const JobOptions &job) {
+  if (!job.parametersSet)
+    throw std::invalid_argument("Parametri A, B, C, D mancanti (--params)");
+  if (!job.initialSet)
+    throw std::invalid_argument("Condizioni iniziali mancanti (--initial)");
+  if (job.A <= 0 || job.B <= 0 || job.C <= 0 || job.D <= 0)
+    throw std::invalid_argument("Tutti i parametri devono essere positivi");
+  if (job.x_0 <= 0 || job.y_0 <= 0)
+    throw std::invalid_argument("Le condizioni iniziali devono essere positive");
+  if (job.dt <= 0 || job.duration <= 0)
+    throw std::invalid_argument("Passo e durata devono essere positivi");
+  if (job.absTol <= 0 || job.relTol <= 0)
+    throw std::invalid_argument("Le tolleranze devono essere positive");
+  // Il numero di passi deve stare in un int (JobOptions::steps)
+  stepsFor(job.duration, job.dt);
+  // Il passo finisce nel campo a 32 bit dell'intestazione binaria
+  if (job.format == OutputFormat::Binary ||
+      job.format == OutputFormat::Compressed ||
+      job.format == OutputFormat::Indexed)
+    binaryStride(job.stride);
+}
+
+// Intestazione dei file binari scritti in streaming
+BinaryTrajectoryHeader headerOf(const JobOptions &job) {
+  BinaryTrajectoryHeader header = makeBinaryHeader();
+  header.method = static_cast<std::uint32_t>(job.method);
+  header.A = job.A;
+  header.B = job.B;
+  header.C = job.C;
+  header.D = job.D;
+  header.x_0 = job.x_0;
+  header.y_0 = job.y_0;
+  header.dt = job.dt;
+  header.stride = binaryStride(job.stride);
+  return header;
+}
+
+} // namespace
+
+int stepsFor(double duration, double dt) {
+  if (!(duration / dt <= static_cast<double>(std::numeric_limits<int>::max())))
+    throw std::invalid_argument("Troppi passi: aumenta il passo o riduci la "
+                                "durata");
+  return static_cast<int>(std::llround(duration / dt));
+}
+
+int JobOptions::steps() const { return stepsFor(duration, dt); }
+
+CommandLine parseCommandLine(const std::vector<std::string> &args) {
+  CommandLine result;
+  JobOptions job;
+  std::string jobFile;
+
+  for (std::size_t i = 0; i < args.size(); ++i) {
+    if (applyOption(job, args, i))
+      continue;
+
+    const std::string &option = args[i];
+    if (option == "--help" || option == "-h") {
+      result.help = true;
+    } else if ((option == "--jobs" || option == "--threads") &&
+               i + 1 >= args.size()) {
+      throw std::invalid_argument("Argomento mancante per " + option);
+    } else if (option == "--jobs") {
+      jobFile = args[++i];
+    } else if (option == "--threads") {
+      double threads = toNumber(option, args[++i]);
+      if (threads < 0 || threads != std::floor(threads))
+        throw std::invalid_argument("--threads deve essere un intero >= 0");
+      result.threads = static_cast<unsigned>(threads);
+    } else {
+      throw std::invalid_argument("Opzione non valida: " + option);
+    }
+  }
+
+  if (result.help)
+    return result;
+
+  if (jobFile.empty()) {
+    validate(job);
+    result.jobs.push_back(job);
+  } else {
+    std::ifstream in(jobFile);
+    if (!in)
+      throw std::invalid_argument("Impossibile aprire " + jobFile);
+    result.jobs = parseJobFile(in, job);
+  }
+  return result;
+}
+
+std::vector<JobOptions> parseJobFile(std::istream &in,
+                                     const JobOptions &defaults) {
+  std::vector<JobOptions> jobs;
+  std::string line;
+  for (int lineNumber = 1; std::getline(in, line); ++lineNumber) {
+    line = line.substr(0, line.find('#'));
+
+    std::istringstream tokens(line);
+    std::vector<std::string> args;
+    for (std::string token; tokens >> token;)
+      args.push_back(token);
+    if (args.empty())
+      continue;
+
+    JobOptions job = defaults;
+    job.prefix =
+        defaults.prefix + "job" + std::to_string(jobs.size() + 1) + "_";
+    try {
+      for (std::size_t i = 0; i < args.size(); ++i) {
+        if (!applyOption(job, args, i))
+          throw std::invalid_argument("Opzione non valida: " + args[i]);
+      }
+      validate(job);
+    } catch (const std::invalid_argument &error) {
+      throw std::invalid_argument("Riga " + std::to_string(lineNumber) + ": " +
+                                  error.what());
+    }
+    jobs.push_back(job);
+  }
+  return jobs;
+}
+
+std::string usage() {
+  return "Uso: lotka_volterra_app [opzioni]\n"
+         "Senza opzioni i parametri vengono chiesti in modo interattivo; con la\n"
+         "sola opzione --live anche l'andamento viene mostrato durante la\n"
+         "simulazione (chiudere la finestra non la interrompe).\n\n"
+         "  --params A B C D       coefficienti del modello\n"
+         "  --initial x_0 y_0      prede e predatori iniziali\n"
+         "  --method NOME          euler, rk4, dp, symplectic (euler)\n"
+         "  --dt VALORE            passo temporale (0.001)\n"
+         "  --duration VALORE      durata della simulazione\n"
+         "  --tolerances ASS REL   tolleranze del metodo dp (1e-8 1e-8)\n"
+         "  --stride N             salva uno stato ogni N passi (1)\n"
+         "  --format NOME          text, shortest, binary, compressed, indexed,\n"
+         "                         none\n"
+         "  --prefix TESTO         prefisso dei file prodotti\n"
+         "  --h-tolerance VALORE   tolleranza della stabilita' di H (1e-4)\n"
+         "  --no-h                 non calcola l'integrale del moto H\n"
+         "  --no-statistics        non scrive Statistics.txt\n"
+         "  --plot                 mostra i grafici al termine\n"
+         "  --jobs FILE            esegue un job per riga del file; le altre\n"
+         "                         opzioni fanno da valori predefiniti\n"
+         "  --threads N            job eseguiti in parallelo (0 = uno per core)\n"
+         "  --help                 mostra questo messaggio\n\n"
+         "Termina con codice 2 se H non e' stabile in almeno un job.\n";
+}
+
+// I dati vengono salvati solo se servono (formati binari o grafici); negli
+// altri casi la simulazione gira in streaming con memoria costante
+JobResult runJob(const JobOptions &job) {
+  Simulation sim(job.A, job.B, job.C, job.D, job.x_0, job.y_0, job.dt);
+  sim.setMethod(job.method);
+  sim.setTolerances(job.absTol, job.relTol);
+  sim.setRecordStride(job.stride);
+  sim.setComputeH(job.computeH);
+  sim.writeCoordinates(job.prefix + "e_2Coordinates.txt");
+
+  JobResult result;
+  bool store = job.plot || job.format == OutputFormat::Binary ||
+               job.format == OutputFormat::Compressed;
+
+  if (store) {
+    sim.initializeVectors();
+    sim.runSimulation(job.steps());
+    switch (job.format) {
+    case OutputFormat::Text:
+      sim.writeResults(TextFormat::Fixed, job.prefix + "ValueList.txt");
+      break;
+    case OutputFormat::Shortest:
+      sim.writeResults(TextFormat::Shortest, job.prefix + "ValueList.txt");
+      break;
+    case OutputFormat::Binary:
+      sim.writeResultsBinary(job.prefix + "ValueList.bin");
+      break;
+    case OutputFormat::Compressed:
+      sim.writeResultsCompressed(job.prefix + "ValueList.lvz");
+      break;
+    case OutputFormat::Indexed:
+      sim.writeResultsIndexed(job.prefix + "ValueList.lvi");
+      break;
+    case OutputFormat::None:
+      break;
+    }
+  } else if (job.format == OutputFormat::None) {
+    DiscardSink sink;
+    sim.runSimulation(job.steps(), sink);
+  } else if (job.format == OutputFormat::Indexed) {
+    IndexedTrajectoryWriter writer(job.prefix + "ValueList.lvi",
+                                   headerOf(job));
+    sim.runSimulation(job.steps(), writer);
+    writer.close();
+  } else {
+    FileSink sink(job.prefix + "ValueList.txt",
+                  job.format == OutputFormat::Shortest ? TextFormat::Shortest
+                                                       : TextFormat::Fixed);
+    sim.runSimulation(job.steps(), sink);
+  }
+
+  // Stabilita' di H dai valori estremi accumulati durante l'integrazione,
+  // scritta come nella modalita' interattiva; senza H non c'e' nulla da
+  // controllare e il job conta come stabile
+  if (job.computeH) {
+    const RunningStats &H = sim.getHStatistics();
+    double H0 = hamiltonian(Coefficients{job.A, job.B, job.C, job.D}, job.x_0,
+                            job.y_0);
+    // Un valore non finito (estinzione) rende H instabile
+    double deviation =
+        H.nonFinite > 0
+            ? std::numeric_limits<double>::infinity()
+            : std::max(std::fabs(H.max - H0), std::fabs(H.min - H0)) /
+                  std::fabs(H0);
+    result.stable = writeHStability(job.prefix + "H_Stability.txt", H0,
+                                    deviation, job.hTolerance);
+  } else {
+    result.stable = true;
+  }
+  if (job.statistics)
+    sim.computeStatistics(job.prefix + "Statistics.txt");
+  result.steps = sim.getStepCount();
+
+  if (job.plot) {
+    PlotSession plots;
+    plots.addEquilibriumPlot(sim.getx(), sim.gety(), job.A, job.B, job.C,
+                             job.D);
+    plots.addTimeEvolution(sim.gett(), sim.getx(), sim.gety());
+    plots.run();
+  }
+  return result;
+}
+
+// Come runSweep: ogni thread prende il prossimo job da un contatore condiviso
+std::size_t runJobs(const std::vector<JobOptions> &jobs, unsigned threads) {
+  if (threads == 0)
+    threads = std::max(1u, std::thread::hardware_concurrency());
+  threads = static_cast<unsigned>(std::min<std::size_t>(threads, jobs.size()));
+
+  std::atomic<std::size_t> next{0};
+  std::atomic<std::size_t> unstable{0};
+  auto worker = [&] {
+    for (std::size_t i = next.fetch_add(1); i < jobs.size();
+         i = next.fetch_add(1)) {
+      JobOptions job = jobs[i];
+      // Le finestre SFML vanno aperte da un solo thread
+      if (threads > 1)
+        job.plot = false;
+      if (!runJob(job).stable)
+        unstable.fetch_add(1);
+    }
+  };
+
+  std::vector<std::thread> pool;
+  for (unsigned i = 1; i < threads; ++i)
+    pool.emplace_back(worker);
+  worker();
+  for (std::thread &thread : pool)
+    thread.join();
+
+  return unstable.load();
+}
+
+} // namespace pf
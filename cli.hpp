@@ -0,0 +1,100 @@
+#ifndef CLI_HPP
+#define CLI_HPP
+
+#include <cstddef>
+#include <istream>
+#include <string>
+#include <vector>
+
+#include "lotka_volterra.hpp"
+
+namespace pf {
+
+// Formato del file dei risultati di un job
+enum class OutputFormat {
+  Text,       // ValueList.txt, 6 cifre decimali
+  Shortest,   // ValueList.txt, rappresentazione esatta piu' corta
+  Binary,     // ValueList.bin, formato a colonne
+  Compressed, // ValueList.lvz, formato compresso
+  Indexed,    // ValueList.lvi, formato indicizzato per istante
+  None        // nessun file dei risultati
+};
+
+// Impostazioni di una simulazione in modalita' non interattiva
+struct JobOptions {
+  double A = 0.0, B = 0.0, C = 0.0, D = 0.0;
+  double x_0 = 0.0, y_0 = 0.0;
+  bool parametersSet = false;
+  bool initialSet = false;
+
+  Method method = Method::Euler;
+  double dt = 0.001;
+  double duration = 0.0;
+  double absTol = 1e-8, relTol = 1e-8;
+  std::size_t stride = 1;
+  bool computeH = true;
+
+  // I file prodotti hanno nome prefix + nome predefinito (ValueList.txt,
+  // Statistics.txt, ...): ad esempio "out/run1_"
+  std::string prefix;
+  OutputFormat format = OutputFormat::Text;
+  bool statistics = true;
+
+  // Tolleranza del controllo di stabilita' di H, il cui esito viene scritto
+  // in H_Stability.txt
+  double hTolerance = 1e-4;
+
+  // Mostra i grafici al termine del job
+  bool plot = false;
+
+  // Numero di passi corrispondente alla durata (parseCommandLine rifiuta i
+  // job con piu' di INT_MAX passi)
+  int steps() const;
+};
+
+// Numero di passi di ampiezza dt che coprono duration, arrotondato al piu'
+// vicino: lo usano sia i job sia la modalita' interattiva, cosi' la stessa
+// durata da' sempre lo stesso numero di passi. Lancia std::invalid_argument
+// se il numero di passi non sta in un int
+int stepsFor(double duration, double dt);
+
+// Opzioni della riga di comando
+struct CommandLine {
+  bool help = false;
+  unsigned threads = 1;
+  std::vector<JobOptions> jobs;
+};
+
+// Legge le opzioni della riga di comando (senza il nome del programma). Le
+// opzioni si applicano al job descritto dalla riga di comando oppure, con
+// --jobs, fanno da valori predefiniti per ogni riga del file dei job. Lancia
+// std::invalid_argument se un'opzione non e' valida
+CommandLine parseCommandLine(const std::vector<std::string> &args);
+
+// Legge un file dei job: ogni riga non vuota (i commenti iniziano con #)
+// descrive un job con le stesse opzioni della riga di comando, a partire da
+// defaults. Senza --prefix, il job n-esimo (da 1) aggiunge "job<n>_" al
+// prefisso di defaults.
+// Lancia std::invalid_argument indicando la riga non valida
+std::vector<JobOptions> parseJobFile(std::istream &in,
+                                     const JobOptions &defaults);
+
+// Testo di aiuto delle opzioni
+std::string usage();
+
+// Esito di un job
+struct JobResult {
+  bool stable = false; // H entro hTolerance (true se H non viene calcolato)
+  long long steps = 0; // passi di integrazione effettuati
+};
+
+// Esegue un job e scrive i file richiesti
+JobResult runJob(const JobOptions &job);
+
+// Esegue i job con threads thread (0 = uno per core): i grafici vengono
+// mostrati solo con un thread. Restituisce il numero di job instabili
+std::size_t runJobs(const std::vector<JobOptions> &jobs, unsigned threads);
+
+} // namespace pf
+
+#endif // CLI_HPP
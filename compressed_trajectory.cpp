@@ -0,0 +1,365 @@
+#include "compressed_trajectory.hpp"
+
+#include <algorithm>
+#include <bit>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <stdexcept>
+#include <utility>
+
+namespace pf {
+
+namespace {
+
+constexpr char compressedMagic[8] = "LVGORI1";
+
+// Maschera che conserva segno, esponente e i primi mantissaBits bit di
+// mantissa
+std::uint64_t keepMaskFor(unsigned mantissaBits) {
+  unsigned drop = 52 - std::min(mantissaBits, 52u);
+  return ~((std::uint64_t{1} << drop) - 1);
+}
+
+// Arrotonda al numero di bit di mantissa conservati; infiniti e NaN vengono
+// solo troncati
+std::uint64_t roundBits(std::uint64_t bits, std::uint64_t keepMask) {
+  std::uint64_t dropped = ~keepMask;
+  constexpr std::uint64_t exponent = std::uint64_t{0x7ff} << 52;
+  if (dropped != 0 && (bits & exponent) != exponent)
+    bits += (dropped >> 1) + 1;
+  return bits & keepMask;
+}
+
+// Intestazione di una colonna nel file compresso
+struct ColumnHeader {
+  std::uint32_t order;
+  std::uint32_t mantissaBits;
+  std::uint64_t count;
+  std::uint64_t bitCount;
+};
+
+void writeColumn(std::ofstream &out, const CompressedColumn &column) {
+  ColumnHeader header{column.getOrder(), column.getMantissaBits(),
+                      column.size(), column.getBitCount()};
+  out.write(reinterpret_cast<const char *>(&header), sizeof header);
+  out.write(reinterpret_cast<const char *>(column.getWords().data()),
+            static_cast<std::streamsize>(column.sizeBytes()));
+}
+
+// remaining: byte del file ancora da leggere. L'intestazione viene
+// controllata prima di allocare le parole: ogni campione occupa almeno un bit
+// e le parole devono stare nel file
+CompressedColumn readColumn(std::ifstream &in, const std::string &path,
+                            std::uint64_t &remaining) {
+  ColumnHeader header{};
+  in.read(reinterpret_cast<char *>(&header), sizeof header);
+  if (!in || remaining < sizeof header)
+    throw std::runtime_error("File compresso troncato: " + path);
+  remaining -= sizeof header;
+
+  std::uint64_t wordCount = header.bitCount / 64 + (header.bitCount % 64 != 0);
+  if (header.order < 1 || header.order > 3 || header.mantissaBits > 52 ||
+      header.count > header.bitCount ||
+      wordCount > remaining / sizeof(std::uint64_t))
+    throw std::runtime_error("File compresso non valido: " + path);
+
+  std::vector<std::uint64_t> words(static_cast<std::size_t>(wordCount));
+  in.read(reinterpret_cast<char *>(words.data()),
+          static_cast<std::streamsize>(words.size() * sizeof(std::uint64_t)));
+  if (!in)
+    throw std::runtime_error("File compresso troncato: " + path);
+  remaining -= wordCount * sizeof(std::uint64_t);
+  return CompressedColumn(header.order, header.mantissaBits,
+                          static_cast<std::size_t>(header.count),
+                          header.bitCount, std::move(words));
+}
+
+} // namespace
+
+std::uint64_t CompressedColumn::Predictor::predict() const {
+  double value = 0.0;
+  switch (std::min<std::size_t>(order, seen)) {
+  case 0:
+    break;
+  case 1:
+    value = history[0];
+    break;
+  case 2:
+    value = history[0] + (history[0] - history[1]);
+    break;
+  default:
+    value = history[2] + 3.0 * (history[0] - history[1]);
+    break;
+  }
+  return std::bit_cast<std::uint64_t>(value) & keepMask;
+}
+
+void CompressedColumn::Predictor::push(double value) {
+  history[2] = history[1];
+  history[1] = history[0];
+  history[0] = value;
+  ++seen;
+}
+
+CompressedColumn::CompressedColumn(unsigned order, unsigned mantissaBits)
+    : mantissa(std::min(mantissaBits, 52u)),
+      predictor{std::clamp(order, 1u, 3u), keepMaskFor(mantissaBits)} {}
+
+CompressedColumn::CompressedColumn(unsigned order, unsigned mantissaBits,
+                                   std::size_t size, std::uint64_t bits,
+                                   std::vector<std::uint64_t> data)
+    : CompressedColumn(order, mantissaBits) {
+  words = std::move(data);
+  bitCount = bits;
+  count = size;
+}
+
+// Aggiunge gli n bit meno significativi di value (1 <= n <= 64), dal piu'
+// significativo
+void CompressedColumn::writeBits(std::uint64_t value, unsigned n) {
+  unsigned used = static_cast<unsigned>(bitCount % 64);
+  if (used == 0)
+    words.push_back(0);
+  unsigned free = 64 - used;
+  if (n <= free) {
+    words.back() |= value << (free - n);
+  } else {
+    words.back() |= value >> (n - free);
+    words.push_back(value << (64 - (n - free)));
+  }
+  bitCount += n;
+}
+
+// Codifica dello XOR tra valore e previsione:
+//   0                    -> uguale alla previsione
+//   10 + bit significativi -> i bit diversi stanno nella finestra precedente
+//   11 + 6 bit di zeri iniziali + 6 bit di lunghezza - 1 + bit significativi
+void CompressedColumn::push(double value) {
+  std::uint64_t bits =
+      roundBits(std::bit_cast<std::uint64_t>(value), predictor.keepMask);
+  std::uint64_t diff = bits ^ predictor.predict();
+
+  if (diff == 0) {
+    writeBits(0, 1);
+  } else {
+    auto leading = static_cast<unsigned>(std::countl_zero(diff));
+    auto trailing = static_cast<unsigned>(std::countr_zero(diff));
+    unsigned length = 64 - leading - trailing;
+    unsigned window = 64 - prevLeading - prevTrailing;
+    // La finestra precedente si riusa solo se conviene: una finestra larga,
+    // ad esempio dopo un cambio di esponente, non resta fissa per sempre
+    if (prevLeading + prevTrailing > 0 && leading >= prevLeading &&
+        trailing >= prevTrailing && window <= length + 12) {
+      writeBits(2, 2);
+      writeBits(diff >> prevTrailing, window);
+    } else {
+      writeBits(3, 2);
+      writeBits(leading, 6);
+      writeBits(length - 1, 6);
+      writeBits(diff >> trailing, length);
+      prevLeading = leading;
+      prevTrailing = trailing;
+    }
+  }
+
+  predictor.push(std::bit_cast<double>(bits));
+  ++count;
+}
+
+void CompressedColumn::clear() {
+  words.clear();
+  bitCount = 0;
+  count = 0;
+  predictor.seen = 0;
+  prevLeading = 0;
+  prevTrailing = 0;
+}
+
+CompressedColumn::Reader::Reader(const CompressedColumn &source)
+    : column(source), predictor{source.predictor.order,
+                                source.predictor.keepMask} {}
+
+// Legge n bit (1 <= n <= 64) a partire dalla posizione corrente; i bit oltre
+// bitCount non vengono mai letti, quindi word + 1 esiste sempre
+std::uint64_t CompressedColumn::Reader::readBits(unsigned n) {
+  if (n > column.bitCount - position)
+    throw std::runtime_error("Colonna compressa non valida: dati esauriti");
+  std::size_t word = static_cast<std::size_t>(position / 64);
+  unsigned used = static_cast<unsigned>(position % 64);
+  unsigned available = 64 - used;
+  std::uint64_t result;
+  if (n <= available) {
+    result = (column.words[word] << used) >> (64 - n);
+  } else {
+    std::uint64_t high =
+        column.words[word] & ((std::uint64_t{1} << available) - 1);
+    std::uint64_t low = column.words[word + 1] >> (64 - (n - available));
+    result = (high << (n - available)) | low;
+  }
+  position += n;
+  return result;
+}
+
+double CompressedColumn::Reader::next() {
+  std::uint64_t diff = 0;
+  if (readBits(1) == 1) {
+    if (readBits(1) == 1) {
+      leading = static_cast<unsigned>(readBits(6));
+      unsigned length = static_cast<unsigned>(readBits(6)) + 1;
+      if (leading + length > 64)
+        throw std::runtime_error("Colonna compressa non valida: finestra "
+                                 "oltre i 64 bit");
+      trailing = 64 - leading - length;
+    }
+    diff = readBits(64 - leading - trailing) << trailing;
+  }
+
+  double value = std::bit_cast<double>(predictor.predict() ^ diff);
+  predictor.push(value);
+  return value;
+}
+
+std::vector<double> CompressedColumn::decode() const {
+  std::vector<double> values;
+  values.reserve(count);
+  Reader reader(*this);
+  for (std::size_t i = 0; i < count; ++i)
+    values.push_back(reader.next());
+  return values;
+}
+
+CompressedTrajectory::CompressedTrajectory(unsigned mantissaBits)
+    : t(2), x(3, mantissaBits), y(3, mantissaBits), H(1, mantissaBits) {}
+
+CompressedTrajectory::CompressedTrajectory(CompressedColumn newt,
+                                           CompressedColumn newx,
+                                           CompressedColumn newy,
+                                           CompressedColumn newH)
+    : t(std::move(newt)), x(std::move(newx)), y(std::move(newy)),
+      H(std::move(newH)) {}
+
+void CompressedTrajectory::push(double ti, double xi, double yi) {
+  t.push(ti);
+  x.push(xi);
+  y.push(yi);
+}
+
+void CompressedTrajectory::push(double ti, double xi, double yi, double Hi) {
+  push(ti, xi, yi);
+  H.push(Hi);
+}
+
+void CompressedTrajectory::clear() {
+  t.clear();
+  x.clear();
+  y.clear();
+  H.clear();
+}
+
+std::size_t CompressedTrajectory::sizeBytes() const {
+  return t.sizeBytes() + x.sizeBytes() + y.sizeBytes() + H.sizeBytes();
+}
+
+TrajectoryChunk CompressedTrajectory::decode() const {
+  TrajectoryChunk chunk;
+  chunk.t = t.decode();
+  chunk.x = x.decode();
+  chunk.y = y.decode();
+  chunk.H = H.decode();
+  return chunk;
+}
+
+void CompressedTrajectory::replay(TrajectorySink &sink,
+                                  std::size_t chunkSize) const {
+  chunkSize = std::max<std::size_t>(chunkSize, 1);
+  CompressedColumn::Reader rt(t), rx(x), ry(y), rH(H);
+  bool withH = hasH();
+
+  TrajectoryChunk chunk;
+  chunk.reserve(std::min(chunkSize, size()));
+  for (std::size_t i = 0; i < size(); ++i) {
+    if (withH)
+      chunk.push(rt.next(), rx.next(), ry.next(), rH.next());
+    else
+      chunk.push(rt.next(), rx.next(), ry.next());
+    if (chunk.size() == chunkSize) {
+      sink.consume(chunk);
+      chunk.clear();
+    }
+  }
+  if (!chunk.empty())
+    sink.consume(chunk);
+  sink.flush();
+}
+
+CompressedSink::CompressedSink(unsigned mantissaBits)
+    : trajectory(mantissaBits) {}
+
+void CompressedSink::consume(const TrajectoryChunk &chunk) {
+  if (chunk.H.empty()) {
+    for (std::size_t m = 0; m < chunk.size(); ++m)
+      trajectory.push(chunk.t[m], chunk.x[m], chunk.y[m]);
+  } else {
+    for (std::size_t m = 0; m < chunk.size(); ++m)
+      trajectory.push(chunk.t[m], chunk.x[m], chunk.y[m], chunk.H[m]);
+  }
+}
+
+const CompressedTrajectory &CompressedSink::get() const { return trajectory; }
+
+void writeCompressedTrajectory(const std::string &path,
+                               BinaryTrajectoryHeader header,
+                               const CompressedTrajectory &trajectory) {
+  std::memcpy(header.magic, compressedMagic, sizeof compressedMagic);
+  header.count = trajectory.size();
+  header.hasH = trajectory.hasH() ? 1 : 0;
+
+  std::ofstream out(path, std::ios::binary);
+  out.write(reinterpret_cast<const char *>(&header), sizeof header);
+  writeColumn(out, trajectory.gett());
+  writeColumn(out, trajectory.getx());
+  writeColumn(out, trajectory.gety());
+  writeColumn(out, trajectory.getH());
+  out.close();
+  if (!out)
+    throw std::runtime_error("Impossibile scrivere " + path);
+}
+
+CompressedTrajectory readCompressedTrajectory(const std::string &path,
+                                              BinaryTrajectoryHeader *header) {
+  std::ifstream in(path, std::ios::binary);
+  if (!in)
+    throw std::runtime_error("Impossibile aprire " + path);
+
+  BinaryTrajectoryHeader fileHeader{};
+  in.read(reinterpret_cast<char *>(&fileHeader), sizeof fileHeader);
+  if (!in || std::memcmp(fileHeader.magic, compressedMagic,
+                         sizeof compressedMagic) != 0) {
+    throw std::runtime_error("File compresso non valido: " + path);
+  }
+  if (header != nullptr)
+    *header = fileHeader;
+
+  std::error_code error;
+  std::uint64_t remaining = std::filesystem::file_size(path, error);
+  if (error || remaining < sizeof fileHeader)
+    throw std::runtime_error("File compresso troncato: " + path);
+  remaining -= sizeof fileHeader;
+
+  CompressedColumn t = readColumn(in, path, remaining);
+  CompressedColumn x = readColumn(in, path, remaining);
+  CompressedColumn y = readColumn(in, path, remaining);
+  CompressedColumn H = readColumn(in, path, remaining);
+
+  // Le colonne devono avere tutte il numero di campioni dell'intestazione
+  std::uint64_t count = fileHeader.count;
+  if (t.size() != count || x.size() != count || y.size() != count ||
+      H.size() != (fileHeader.hasH ? count : 0))
+    throw std::runtime_error("File compresso non valido: " + path);
+
+  return CompressedTrajectory(std::move(t), std::move(x), std::move(y),
+                              std::move(H));
+}
+
+} // namespace pf
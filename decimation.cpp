@@ -0,0 +1,310 @@
+#include "decimation.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <numeric>
+#include <unordered_set>
+#include <utility>
+
+namespace pf {
+
+namespace {
+
+// Cella della griglia che contiene un punto
+struct Cell {
+  std::int64_t i, j;
+
+  bool operator==(const Cell &) const = default;
+};
+
+// Passaggio da una cella alla successiva
+struct Transition {
+  Cell from, to;
+
+  bool operator==(const Transition &) const = default;
+};
+
+struct TransitionHash {
+  std::size_t operator()(const Transition &step) const {
+    std::size_t h = 0;
+    for (std::int64_t v : {step.from.i, step.from.j, step.to.i, step.to.j})
+      h = h * 0x9e3779b97f4a7c15ULL + std::hash<std::int64_t>{}(v);
+    return h;
+  }
+};
+
+std::vector<std::size_t> allIndices(std::size_t n) {
+  std::vector<std::size_t> indices(n);
+  std::iota(indices.begin(), indices.end(), std::size_t{0});
+  return indices;
+}
+
+} // namespace
+
+std::vector<std::size_t> decimateMinMax(std::span<const double> t,
+                                        std::span<const double> v,
+                                        std::size_t columns) {
+  std::size_t n = std::min(t.size(), v.size());
+  if (columns == 0 || n <= 4 * columns)
+    return allIndices(n);
+
+  double t0 = t[0], duration = t[n - 1] - t[0];
+  auto columnOf = [&](std::size_t i) {
+    if (!(duration > 0.0))
+      return std::size_t{0};
+    auto c = static_cast<std::size_t>((t[i] - t0) / duration *
+                                      static_cast<double>(columns));
+    return std::min(c, columns - 1);
+  };
+
+  std::vector<std::size_t> indices;
+  indices.reserve(4 * columns);
+  std::size_t i = 0;
+  while (i < n) {
+    // Campioni [i, end) nella stessa colonna
+    std::size_t column = columnOf(i);
+    std::size_t end = i + 1;
+    std::size_t low = i, high = i;
+    while (end < n && columnOf(end) == column) {
+      if (v[end] < v[low])
+        low = end;
+      if (v[end] > v[high])
+        high = end;
+      ++end;
+    }
+
+    std::size_t picked[4] = {i, std::min(low, high), std::max(low, high),
+                             end - 1};
+    for (std::size_t index : picked)
+      if (indices.empty() || indices.back() != index)
+        indices.push_back(index);
+    i = end;
+  }
+  return indices;
+}
+
+std::vector<std::size_t> decimatePath(std::span<const double> x,
+                                      std::span<const double> y, double cellX,
+                                      double cellY) {
+  std::size_t n = std::min(x.size(), y.size());
+  std::vector<std::size_t> segments;
+  if (n < 2)
+    return segments;
+
+  if (!(cellX > 0.0) || !(cellY > 0.0) || !std::isfinite(cellX) ||
+      !std::isfinite(cellY)) {
+    segments.reserve(2 * (n - 1));
+    for (std::size_t i = 1; i < n; ++i) {
+      segments.push_back(i - 1);
+      segments.push_back(i);
+    }
+    return segments;
+  }
+
+  auto cellOf = [&](std::size_t i) {
+    return Cell{static_cast<std::int64_t>(std::floor(x[i] / cellX)),
+                static_cast<std::int64_t>(std::floor(y[i] / cellY))};
+  };
+
+  // Il segmento parte dal punto con cui la curva e' entrata nella cella
+  std::unordered_set<Transition, TransitionHash> drawn;
+  std::size_t anchor = 0;
+  Cell current = cellOf(0);
+  for (std::size_t i = 1; i < n; ++i) {
+    Cell next = cellOf(i);
+    if (next == current)
+      continue;
+    if (drawn.insert(Transition{current, next}).second) {
+      segments.push_back(anchor);
+      segments.push_back(i);
+    }
+    anchor = i;
+    current = next;
+  }
+
+  // Curva interamente in una cella: un solo segmento
+  if (segments.empty()) {
+    segments.push_back(0);
+    segments.push_back(n - 1);
+  }
+  return segments;
+}
+
+StreamingDecimator::StreamingDecimator(std::size_t bucketLimit)
+    : maxBuckets(std::max<std::size_t>(bucketLimit, 2)) {}
+
+void StreamingDecimator::push(double t, double v) {
+  Point p{t, v};
+  if (buckets.empty()) {
+    t0 = t;
+    vMin = vMax = v;
+    buckets.push_back(Bucket{0, p, p, p, p});
+    return;
+  }
+  vMin = std::min(vMin, v);
+  vMax = std::max(vMax, v);
+
+  // L'ampiezza iniziale e' il primo passo temporale
+  if (width == 0.0 && t > t0)
+    width = t - t0;
+
+  long long index = 0;
+  if (width > 0.0)
+    index = static_cast<long long>(std::floor((t - t0) / width));
+
+  Bucket &current = buckets.back();
+  if (index <= current.index) {
+    if (v < current.low.v)
+      current.low = p;
+    if (v > current.high.v)
+      current.high = p;
+    current.last = p;
+    return;
+  }
+
+  buckets.push_back(Bucket{index, p, p, p, p});
+  if (buckets.size() > maxBuckets)
+    merge();
+}
+
+// Unisce gli intervalli che dopo il raddoppio dell'ampiezza coincidono
+void StreamingDecimator::merge() {
+  width *= 2.0;
+  std::size_t kept = 0;
+  for (std::size_t i = 0; i < buckets.size(); ++i) {
+    Bucket bucket = buckets[i];
+    bucket.index /= 2;
+    if (kept > 0 && buckets[kept - 1].index == bucket.index) {
+      Bucket &target = buckets[kept - 1];
+      if (bucket.low.v < target.low.v)
+        target.low = bucket.low;
+      if (bucket.high.v > target.high.v)
+        target.high = bucket.high;
+      target.last = bucket.last;
+    } else {
+      buckets[kept++] = bucket;
+    }
+  }
+  buckets.resize(kept);
+}
+
+std::vector<StreamingDecimator::Point> StreamingDecimator::points() const {
+  std::vector<Point> result;
+  result.reserve(4 * buckets.size());
+  for (const Bucket &bucket : buckets) {
+    bool lowFirst = bucket.low.t <= bucket.high.t;
+    Point picked[4] = {bucket.first, lowFirst ? bucket.low : bucket.high,
+                       lowFirst ? bucket.high : bucket.low, bucket.last};
+    for (const Point &p : picked)
+      if (result.empty() || !(result.back() == p))
+        result.push_back(p);
+  }
+  return result;
+}
+
+MinMaxPyramid::MinMaxPyramid(std::span<const double> times,
+                             std::span<const double> values,
+                             std::size_t blockSize)
+    : t(times.first(std::min(times.size(), values.size()))),
+      v(values.first(std::min(times.size(), values.size()))),
+      base(std::max<std::size_t>(blockSize, 1)) {
+  std::vector<Extremes> level(v.size() / base);
+  for (std::size_t k = 0; k < level.size(); ++k) {
+    std::size_t first = k * base;
+    Extremes e{first, first};
+    for (std::size_t i = first + 1; i < first + base; ++i) {
+      if (v[i] < v[e.low])
+        e.low = i;
+      if (v[i] > v[e.high])
+        e.high = i;
+    }
+    level[k] = e;
+  }
+
+  // Ogni livello unisce le coppie complete del precedente
+  while (!level.empty()) {
+    std::vector<Extremes> next(level.size() / 2);
+    for (std::size_t k = 0; k < next.size(); ++k) {
+      Extremes a = level[2 * k], b = level[2 * k + 1];
+      next[k] = {v[b.low] < v[a.low] ? b.low : a.low,
+                 v[b.high] > v[a.high] ? b.high : a.high};
+    }
+    levels.push_back(std::move(level));
+    level = std::move(next);
+  }
+}
+
+// I campioni fuori dai blocchi allineati vengono letti direttamente, il resto
+// risale la piramide come in un albero di segmenti
+MinMaxPyramid::Extremes MinMaxPyramid::extremes(std::size_t first,
+                                                std::size_t last) const {
+  Extremes e{first, first};
+  auto take = [&](Extremes other) {
+    if (v[other.low] < v[e.low])
+      e.low = other.low;
+    if (v[other.high] > v[e.high])
+      e.high = other.high;
+  };
+
+  while (first < last && first % base != 0)
+    take({first, first}), ++first;
+  while (last > first && last % base != 0)
+    --last, take({last, last});
+
+  std::size_t lo = first / base, hi = last / base;
+  for (std::size_t level = 0; lo < hi; ++level) {
+    if (lo % 2 == 1)
+      take(levels[level][lo++]);
+    if (hi % 2 == 1)
+      take(levels[level][--hi]);
+    lo /= 2;
+    hi /= 2;
+  }
+  return e;
+}
+
+std::vector<std::size_t> MinMaxPyramid::visible(double tBegin, double tEnd,
+                                                std::size_t columns) const {
+  std::vector<std::size_t> indices;
+  auto indexOf = [&](double time) {
+    return static_cast<std::size_t>(
+        std::lower_bound(t.begin(), t.end(), time) - t.begin());
+  };
+  std::size_t first = indexOf(tBegin);
+  std::size_t last = static_cast<std::size_t>(
+      std::upper_bound(t.begin(), t.end(), tEnd) - t.begin());
+  if (first >= last)
+    return indices;
+
+  // Pochi campioni visibili: nessuna riduzione
+  if (columns == 0 || last - first <= 4 * columns) {
+    indices.resize(last - first);
+    std::iota(indices.begin(), indices.end(), first);
+    return indices;
+  }
+
+  indices.reserve(4 * columns);
+  double width = (tEnd - tBegin) / static_cast<double>(columns);
+  std::size_t begin = first;
+  for (std::size_t c = 1; c <= columns && begin < last; ++c) {
+    std::size_t end =
+        c == columns
+            ? last
+            : std::max(begin, std::min(last, indexOf(tBegin + width *
+                                                   static_cast<double>(c))));
+    if (end == begin)
+      continue;
+
+    Extremes e = extremes(begin, end);
+    std::size_t picked[4] = {begin, std::min(e.low, e.high),
+                             std::max(e.low, e.high), end - 1};
+    for (std::size_t index : picked)
+      if (indices.empty() || indices.back() != index)
+        indices.push_back(index);
+    begin = end;
+  }
+  return indices;
+}
+
+} // namespace pf
@@ -0,0 +1,118 @@
+#ifndef DECIMATION_HPP
+#define DECIMATION_HPP
+
+#include <cstddef>
+#include <span>
+#include <vector>
+
+namespace pf {
+
+// Riduzione dei campioni da disegnare: una curva con piu' punti che pixel
+// viene ridotta a pochi vertici per pixel senza differenze visibili, cosi' il
+// costo del disegno non cresce con la durata della simulazione
+
+// Indici (crescenti) dei campioni da disegnare per la curva v(t), con t
+// crescente, su columns colonne di pixel tra t.front() e t.back(): per ogni
+// colonna il primo e l'ultimo campione e quelli di valore minimo e massimo,
+// quindi al piu' 4 * columns indici. I picchi restano visibili e la spezzata
+// tra colonne vicine resta collegata. Con pochi campioni restituisce tutti gli
+// indici
+std::vector<std::size_t> decimateMinMax(std::span<const double> t,
+                                        std::span<const double> v,
+                                        std::size_t columns);
+
+// Segmenti da disegnare (coppie di indici, per sf::Lines) per la curva
+// parametrica (x, y) su una griglia di celle cellX x cellY (un pixel): i
+// movimenti interni a una cella vengono ignorati e ogni passaggio tra due
+// celle viene disegnato una volta sola. Un'orbita chiusa percorsa molte
+// volte costa quindi quanto un solo giro. Con celle non positive restituisce
+// tutti i segmenti
+std::vector<std::size_t> decimatePath(std::span<const double> x,
+                                      std::span<const double> y, double cellX,
+                                      double cellY);
+
+// Versione incrementale di decimateMinMax per una curva v(t) che cresce
+// mentre viene disegnata: i campioni (con t crescente) vengono raggruppati in
+// intervalli di tempo di uguale ampiezza, di cui restano il primo e l'ultimo
+// campione e quelli di valore minimo e massimo. Quando gli intervalli superano
+// maxBuckets quelli vicini vengono uniti a due a due e l'ampiezza raddoppia:
+// memoria e vertici da disegnare restano limitati qualunque sia la durata
+class StreamingDecimator {
+public:
+  struct Point {
+    double t, v;
+
+    bool operator==(const Point &) const = default;
+  };
+
+private:
+  struct Bucket {
+    // Intervallo [t0 + index * width, t0 + (index + 1) * width)
+    long long index;
+    Point first, low, high, last;
+  };
+
+  std::size_t maxBuckets;
+  std::vector<Bucket> buckets;
+  double t0 = 0.0;
+  double width = 0.0; // 0 finche' non arriva un secondo istante
+  double vMin = 0.0;
+  double vMax = 0.0;
+
+  void merge();
+
+public:
+  explicit StreamingDecimator(std::size_t bucketLimit = 1024);
+
+  void push(double t, double v);
+
+  // Punti da disegnare, in ordine di tempo: al piu' 4 * maxBuckets
+  std::vector<Point> points() const;
+
+  bool empty() const { return buckets.empty(); }
+  std::size_t bucketCount() const { return buckets.size(); }
+
+  // Intervallo dei tempi e dei valori ricevuti (validi se non vuoto)
+  double tFirst() const { return t0; }
+  double tLast() const { return buckets.back().last.t; }
+  double min() const { return vMin; }
+  double max() const { return vMax; }
+};
+
+// Piramide di minimi e massimi per zoom e spostamento su curve v(t) molto
+// lunghe, con t crescente: il livello 0 contiene gli indici del minimo e del
+// massimo di ogni blocco di blockSize campioni, ogni livello successivo unisce
+// i blocchi a due a due. Minimo e massimo di un qualsiasi intervallo di
+// campioni si ottengono da O(blockSize + log n) voci, quindi disegnare una
+// finestra di tempo costa in proporzione alle colonne di pixel e non ai
+// campioni. times e values non vengono copiati e devono restare validi
+class MinMaxPyramid {
+private:
+  struct Extremes {
+    std::size_t low, high;
+  };
+
+  std::span<const double> t, v;
+  std::size_t base;
+  std::vector<std::vector<Extremes>> levels;
+
+  // Indici del minimo e del massimo tra i campioni [first, last), non vuoto
+  Extremes extremes(std::size_t first, std::size_t last) const;
+
+public:
+  MinMaxPyramid(std::span<const double> times, std::span<const double> values,
+                std::size_t blockSize = 64);
+
+  // Come decimateMinMax, ma solo per i campioni con t in [tBegin, tEnd]:
+  // indici crescenti del primo, dell'ultimo, del minimo e del massimo di
+  // ciascuna delle columns colonne in cui e' diviso l'intervallo
+  std::vector<std::size_t> visible(double tBegin, double tEnd,
+                                   std::size_t columns) const;
+
+  std::size_t size() const { return v.size(); }
+  std::size_t levelCount() const { return levels.size(); }
+};
+
+} // namespace pf
+
+#endif // DECIMATION_HPP
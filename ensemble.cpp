@@ -0,0 +1,309 @@
+#include "ensemble.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <iomanip>
+
+namespace pf {
+
+// Numero di sistemi fatti avanzare insieme per tutti i passi di
+// runSimulation: il blocco (7 vettori) resta nella cache L1/L2
+constexpr std::size_t blockSize = 512;
+
+// Costruttore con il passo temporale comune
+template <class State, class Accum>
+BasicEnsemble<State, Accum>::BasicEnsemble(double new_dt)
+    : dt(static_cast<State>(new_dt)) {}
+
+// Copia sistemi e stato corrente convertendo la precisione
+template <class State, class Accum>
+template <class OtherState, class OtherAccum>
+BasicEnsemble<State, Accum>::BasicEnsemble(
+    const BasicEnsemble<OtherState, OtherAccum> &other)
+    : dt(static_cast<State>(other.dt)), useRK4(other.useRK4),
+      trackHDeviation(other.trackHDeviation) {
+  reserve(other.size());
+  for (std::size_t i = 0; i < other.size(); ++i) {
+    addSystem(other.A[i], other.B[i], other.C[i], other.D[i], other.x[i],
+              other.y[i]);
+  }
+}
+
+// Aggiunge un sistema con i suoi coefficienti e condizioni iniziali
+template <class State, class Accum>
+std::size_t BasicEnsemble<State, Accum>::addSystem(double newA, double newB,
+                                                   double newC, double newD,
+                                                   double newx_0,
+                                                   double newy_0) {
+  A.push_back(static_cast<State>(newA));
+  B.push_back(static_cast<State>(newB));
+  C.push_back(static_cast<State>(newC));
+  D.push_back(static_cast<State>(newD));
+  x.push_back(static_cast<State>(newx_0));
+  y.push_back(static_cast<State>(newy_0));
+  H.push_back(Accum{});
+  H0.push_back(Accum{});
+  maxHDeviation.push_back(Accum{});
+
+  // Calcolo iniziale della funzione H, come in Simulation::initializeVectors
+  std::size_t i = x.size() - 1;
+  updateH(i, i + 1);
+  H0[i] = H[i];
+  return i;
+}
+
+template <class State, class Accum>
+void BasicEnsemble<State, Accum>::reserve(std::size_t n) {
+  for (auto *v : {&A, &B, &C, &D, &x, &y})
+    v->reserve(n);
+  for (auto *v : {&H, &H0, &maxHDeviation})
+    v->reserve(n);
+}
+
+template <class State, class Accum>
+std::size_t BasicEnsemble<State, Accum>::size() const {
+  return x.size();
+}
+
+// Imposta se utilizzare il metodo Runge-Kutta 4 (RK4) per l'evoluzione
+template <class State, class Accum>
+void BasicEnsemble<State, Accum>::setUseRK4(bool flag) {
+  useRK4 = flag;
+}
+
+// Il controllo di H riparte dallo stato corrente
+template <class State, class Accum>
+void BasicEnsemble<State, Accum>::setTrackHDeviation(bool flag) {
+  trackHDeviation = flag;
+  updateH(0, size());
+  H0 = H;
+  std::fill(maxHDeviation.begin(), maxHDeviation.end(), Accum{});
+}
+
+template <class State, class Accum>
+const std::vector<State> &BasicEnsemble<State, Accum>::getx() const {
+  return x;
+}
+template <class State, class Accum>
+const std::vector<State> &BasicEnsemble<State, Accum>::gety() const {
+  return y;
+}
+template <class State, class Accum>
+const std::vector<Accum> &BasicEnsemble<State, Accum>::getH() const {
+  return H;
+}
+template <class State, class Accum>
+const std::vector<Accum> &
+BasicEnsemble<State, Accum>::getMaxHDeviation() const {
+  return maxHDeviation;
+}
+
+// Kernel di Euler esplicito: stessa formula relativa di Simulation::evolve,
+// scritta senza salti cosi' che il compilatore la possa vettorizzare. Tutte le
+// costanti sono di tipo State per non promuovere i calcoli in float a double
+template <class State, class Accum>
+void BasicEnsemble<State, Accum>::stepEuler(std::size_t begin,
+                                            std::size_t end) {
+  const State *a = A.data(), *b = B.data(), *c = C.data(), *d = D.data();
+  State *px = x.data(), *py = y.data();
+  const State h = dt;
+  const State one = 1, zero = 0;
+  const State threshold = static_cast<State>(1e-6);
+
+  for (std::size_t i = begin; i < end; ++i) {
+    // Variabili relative rispetto al punto di equilibrio e_2
+    State e2x = d[i] / c[i];
+    State e2y = a[i] / b[i];
+    State x_rel = px[i] / e2x;
+    State y_rel = py[i] / e2y;
+
+    State x_i = (x_rel + a[i] * (one - y_rel) * x_rel * h) * e2x;
+    State y_i = (y_rel + d[i] * (x_rel - one) * y_rel * h) * e2y;
+
+    // Sotto soglia → estinzione
+    px[i] = x_i <= threshold ? zero : x_i;
+    py[i] = y_i <= threshold ? zero : y_i;
+  }
+}
+
+// Kernel RK4: stesse operazioni, nello stesso ordine, di Simulation::evolveRK4
+template <class State, class Accum>
+void BasicEnsemble<State, Accum>::stepRK4(std::size_t begin, std::size_t end) {
+  const State *a = A.data(), *b = B.data(), *c = C.data(), *d = D.data();
+  State *px = x.data(), *py = y.data();
+  const State h = dt;
+  const State half = static_cast<State>(0.5), two = 2, six = 6, zero = 0;
+  const State threshold = static_cast<State>(1e-6);
+
+  for (std::size_t i = begin; i < end; ++i) {
+    State x0 = px[i], y0 = py[i];
+
+    State k1x = a[i] * x0 - b[i] * x0 * y0;
+    State k1y = c[i] * x0 * y0 - d[i] * y0;
+
+    State x1 = x0 + half * h * k1x, y1 = y0 + half * h * k1y;
+    State k2x = a[i] * x1 - b[i] * x1 * y1;
+    State k2y = c[i] * x1 * y1 - d[i] * y1;
+
+    State x2 = x0 + half * h * k2x, y2 = y0 + half * h * k2y;
+    State k3x = a[i] * x2 - b[i] * x2 * y2;
+    State k3y = c[i] * x2 * y2 - d[i] * y2;
+
+    State x3 = x0 + h * k3x, y3 = y0 + h * k3y;
+    State k4x = a[i] * x3 - b[i] * x3 * y3;
+    State k4y = c[i] * x3 * y3 - d[i] * y3;
+
+    State x_next = x0 + (h / six) * (k1x + two * k2x + two * k3x + k4x);
+    State y_next = y0 + (h / six) * (k1y + two * k2y + two * k3y + k4y);
+
+    // Controllo di estinzione
+    px[i] = x_next <= threshold ? zero : x_next;
+    py[i] = y_next <= threshold ? zero : y_next;
+  }
+}
+
+// Calcolo di H in precisione Accum: in caso di estinzione (popolazione
+// azzerata) e' infinito
+template <class State, class Accum>
+void BasicEnsemble<State, Accum>::updateH(std::size_t begin, std::size_t end) {
+  for (std::size_t i = begin; i < end; ++i) {
+    if (x[i] <= State{} || y[i] <= State{}) {
+      H[i] = std::numeric_limits<Accum>::infinity();
+    } else {
+      Accum xi = x[i], yi = y[i];
+      H[i] = -Accum{D[i]} * std::log(xi) + Accum{C[i]} * xi +
+             Accum{B[i]} * yi - Accum{A[i]} * std::log(yi);
+    }
+  }
+}
+
+// Deviazione relativa di H rispetto al valore iniziale, come in
+// Simulation::checkHStability
+template <class State, class Accum>
+void BasicEnsemble<State, Accum>::updateHDeviation(std::size_t begin,
+                                                   std::size_t end) {
+  for (std::size_t i = begin; i < end; ++i) {
+    Accum deviation = std::fabs(H[i] - H0[i]) / std::fabs(H0[i]);
+    if (deviation > maxHDeviation[i])
+      maxHDeviation[i] = deviation;
+  }
+}
+
+template <class State, class Accum>
+void BasicEnsemble<State, Accum>::step(std::size_t begin, std::size_t end) {
+  if (useRK4) {
+    stepRK4(begin, end);
+  } else {
+    stepEuler(begin, end);
+  }
+  if (trackHDeviation) {
+    updateH(begin, end);
+    updateHDeviation(begin, end);
+  }
+}
+
+// Un passo di Euler esplicito per tutti i sistemi
+template <class State, class Accum> void BasicEnsemble<State, Accum>::evolve() {
+  stepEuler(0, size());
+  updateH(0, size());
+  if (trackHDeviation)
+    updateHDeviation(0, size());
+}
+
+// Un passo RK4 per tutti i sistemi
+template <class State, class Accum>
+void BasicEnsemble<State, Accum>::evolveRK4() {
+  stepRK4(0, size());
+  updateH(0, size());
+  if (trackHDeviation)
+    updateHDeviation(0, size());
+}
+
+// Esegue n passi: i sistemi sono indipendenti, quindi ogni blocco viene fatto
+// avanzare per tutti gli n passi prima di passare al successivo
+template <class State, class Accum>
+void BasicEnsemble<State, Accum>::runSimulation(int n) {
+  for (std::size_t begin = 0; begin < size(); begin += blockSize) {
+    std::size_t end = std::min(begin + blockSize, size());
+    for (int i = 1; i <= n; ++i)
+      step(begin, end);
+    updateH(begin, end);
+  }
+}
+
+// Istanziazioni esplicite delle precisioni disponibili
+template class BasicEnsemble<double>;
+template class BasicEnsemble<float>;
+template class BasicEnsemble<float, double>;
+template BasicEnsemble<float>::BasicEnsemble(const BasicEnsemble<double> &);
+template BasicEnsemble<float, double>::BasicEnsemble(
+    const BasicEnsemble<double> &);
+
+namespace {
+
+// Confronta un insieme gia' evoluto con il riferimento in doppia precisione
+template <class State, class Accum>
+PrecisionResult compare(const std::string &name,
+                        const BasicEnsemble<State, Accum> &ensemble,
+                        const Ensemble &reference, double tolerance) {
+  PrecisionResult result{name, 0.0, 0, 0.0};
+
+  for (std::size_t i = 0; i < ensemble.size(); ++i) {
+    double deviation = static_cast<double>(ensemble.getMaxHDeviation()[i]);
+    result.maxHDeviation = std::max(result.maxHDeviation, deviation);
+    if (deviation <= tolerance)
+      ++result.stableSystems;
+
+    // Scarto relativo, con la soglia di estinzione come denominatore minimo
+    for (auto [value, ref] :
+         {std::pair{static_cast<double>(ensemble.getx()[i]),
+                    reference.getx()[i]},
+          std::pair{static_cast<double>(ensemble.gety()[i]),
+                    reference.gety()[i]}}) {
+      double error = std::fabs(value - ref) / std::max(std::fabs(ref), 1e-6);
+      result.maxStateError = std::max(result.maxStateError, error);
+    }
+  }
+  return result;
+}
+
+} // namespace
+
+std::vector<PrecisionResult> writePrecisionReport(const Ensemble &systems,
+                                                  int n, double tolerance,
+                                                  const std::string &path) {
+  Ensemble reference(systems);
+  EnsembleFloat single(systems);
+  EnsembleMixed mixed(systems);
+
+  reference.setTrackHDeviation(true);
+  single.setTrackHDeviation(true);
+  mixed.setTrackHDeviation(true);
+
+  reference.runSimulation(n);
+  single.runSimulation(n);
+  mixed.runSimulation(n);
+
+  std::vector<PrecisionResult> results{
+      compare("double", reference, reference, tolerance),
+      compare("float", single, reference, tolerance),
+      compare("float/double (H)", mixed, reference, tolerance)};
+
+  std::ofstream out(path);
+  out << std::scientific << std::setprecision(6);
+  out << "CONFRONTO DI PRECISIONE (" << systems.size() << " sistemi, " << n
+      << " passi)\n\n";
+  for (const PrecisionResult &r : results) {
+    out << r.name << ":\n"
+        << "  Massima deviazione relativa di H: " << r.maxHDeviation << "\n"
+        << "  Sistemi stabili (tolleranza " << tolerance
+        << "): " << r.stableSystems << "/" << systems.size() << "\n"
+        << "  Massimo scarto rispetto a double: " << r.maxStateError << "\n\n";
+  }
+  out.close();
+
+  return results;
+}
+
+} // namespace pf
@@ -0,0 +1,131 @@
+#ifndef ENSEMBLE_HPP
+#define ENSEMBLE_HPP
+
+#include <cstddef>
+#include <limits>
+#include <string>
+#include <vector>
+
+namespace pf {
+
+// Insieme di molti sistemi Lotka-Volterra indipendenti, memorizzati in forma
+// structure-of-arrays: ogni grandezza (coefficienti, popolazioni, H) e' un
+// vettore contiguo, cosi' i kernel di evoluzione fanno avanzare piu' sistemi
+// per istruzione (AVX2/AVX-512 se il compilatore li ha a disposizione).
+// State e' il tipo usato per lo stato e per i kernel, Accum quello usato per H:
+// con State = float una istruzione vettoriale elabora il doppio dei sistemi
+template <class State, class Accum = State> class BasicEnsemble {
+private:
+  template <class, class> friend class BasicEnsemble;
+
+  // Coefficienti dei sistemi, uno per corsia
+  std::vector<State> A, B, C, D;
+
+  // Stato corrente di prede e predatori
+  std::vector<State> x, y;
+
+  // Integrale del moto relativo allo stato corrente
+  std::vector<Accum> H;
+
+  // H iniziale e massima deviazione relativa di H di ciascun sistema
+  std::vector<Accum> H0, maxHDeviation;
+
+  // Passo temporale comune a tutti i sistemi
+  State dt;
+
+  // Flag per decidere se usare il metodo Runge-Kutta 4 (RK4)
+  bool useRK4 = false;
+
+  // Flag per controllare la deviazione di H a ogni passo
+  bool trackHDeviation = false;
+
+  // Kernel di evoluzione sui sistemi [begin, end)
+  void stepEuler(std::size_t begin, std::size_t end);
+  void stepRK4(std::size_t begin, std::size_t end);
+
+  // Ricalcola H per i sistemi [begin, end)
+  void updateH(std::size_t begin, std::size_t end);
+
+  // Aggiorna la massima deviazione di H dei sistemi [begin, end)
+  void updateHDeviation(std::size_t begin, std::size_t end);
+
+  // Un passo per i sistemi [begin, end) con il metodo scelto
+  void step(std::size_t begin, std::size_t end);
+
+public:
+  // Costruttore con il passo temporale comune
+  explicit BasicEnsemble(double new_dt);
+
+  // Copia sistemi e stato corrente da un insieme con un'altra precisione
+  template <class OtherState, class OtherAccum>
+  explicit BasicEnsemble(const BasicEnsemble<OtherState, OtherAccum> &other);
+
+  // Aggiunge un sistema e ne restituisce l'indice
+  std::size_t addSystem(double newA, double newB, double newC, double newD,
+                        double newx_0, double newy_0);
+
+  // Riserva spazio per n sistemi
+  void reserve(std::size_t n);
+
+  // Numero di sistemi contenuti
+  std::size_t size() const;
+
+  // Imposta se utilizzare il metodo RK4 per l'evoluzione
+  void setUseRK4(bool flag);
+
+  // Imposta se calcolare H a ogni passo per tenere traccia della sua massima
+  // deviazione relativa (come checkHStability); costa due logaritmi per passo
+  void setTrackHDeviation(bool flag);
+
+  // Getter per lo stato corrente di tutti i sistemi
+  const std::vector<State> &getx() const;
+  const std::vector<State> &gety() const;
+  const std::vector<Accum> &getH() const;
+
+  // Massima deviazione relativa di H di ciascun sistema dall'inizio del
+  // controllo
+  const std::vector<Accum> &getMaxHDeviation() const;
+
+  // Fa avanzare tutti i sistemi di un passo con Euler esplicito
+  void evolve();
+
+  // Fa avanzare tutti i sistemi di un passo con RK4
+  void evolveRK4();
+
+  // Esegue n passi per tutti i sistemi; H viene aggiornato alla fine
+  void runSimulation(int n);
+};
+
+// Doppia precisione, stessi risultati di Simulation
+using Ensemble = BasicEnsemble<double>;
+
+// Singola precisione per stato e H
+using EnsembleFloat = BasicEnsemble<float>;
+
+// Stato in singola precisione, H calcolato e accumulato in doppia
+using EnsembleMixed = BasicEnsemble<float, double>;
+
+// Risultato del confronto di accuratezza di una precisione con la doppia
+struct PrecisionResult {
+  std::string name;
+
+  // Massima deviazione relativa di H tra tutti i sistemi
+  double maxHDeviation;
+
+  // Numero di sistemi con deviazione di H entro la tolleranza
+  std::size_t stableSystems;
+
+  // Massimo scarto relativo dello stato finale rispetto alla doppia precisione
+  double maxStateError;
+};
+
+// Esegue i sistemi di systems (dallo stato corrente) per n passi in doppia,
+// singola e mista precisione e scrive su file, per ciascuna, la deviazione di
+// H, il numero di sistemi stabili entro tolerance e lo scarto dalla doppia
+std::vector<PrecisionResult>
+writePrecisionReport(const Ensemble &systems, int n, double tolerance,
+                     const std::string &path = "Precision_Report.txt");
+
+} // namespace pf
+
+#endif // ENSEMBLE_HPP
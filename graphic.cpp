@@ -2,6 +2,195 @@
 
 namespace pf {
 
+namespace {
+
+// Geometria che non cambia durante la vita della finestra: viene caricata una
+// volta nella memoria della scheda video (sf::VertexBuffer con uso Static) e
+// ogni ridisegno costa una sola chiamata. Se i vertex buffer non sono
+// disponibili resta un sf::VertexArray
+class StaticGeometry : public sf::Drawable {
+private:
+  sf::VertexArray vertices;
+  sf::VertexBuffer buffer;
+  bool uploaded = false;
+
+  void draw(sf::RenderTarget &target, sf::RenderStates states) const override {
+    if (uploaded)
+      target.draw(buffer, states);
+    else
+      target.draw(vertices, states);
+  }
+
+public:
+  StaticGeometry() = default;
+  explicit StaticGeometry(const sf::VertexArray &source) { load(source); }
+
+  // Sostituisce la geometria
+  void load(const sf::VertexArray &source) {
+    vertices = source;
+    buffer.setPrimitiveType(source.getPrimitiveType());
+    buffer.setUsage(sf::VertexBuffer::Static);
+    uploaded = false;
+    std::size_t n = source.getVertexCount();
+    if (n > 0 && sf::VertexBuffer::isAvailable() && buffer.create(n) &&
+        buffer.update(&source[0])) {
+      uploaded = true;
+      vertices.clear();
+    }
+  }
+};
+
+// Eventi dopo i quali il contenuto della finestra va ridisegnato. SFML non
+// segnala quando una finestra coperta torna visibile, quindi si ridisegna
+// anche al ritorno del focus o del mouse
+bool needsRedraw(const sf::Event &event) {
+  return event.type == sf::Event::Resized ||
+         event.type == sf::Event::GainedFocus ||
+         event.type == sf::Event::MouseEntered;
+}
+
+// Cornice del grafico temporale: assi, titoli, legenda, tacche e valori.
+// Prede e predatori condividono l'asse verticale; setRange ricostruisce
+// tacche e valori per nuovi intervalli, ad esempio mentre la curva cresce
+class TimeFrame : public sf::Drawable {
+private:
+  static constexpr float leftMargin = 70.0f;
+  static constexpr float bottomMargin = 70.0f;
+  static constexpr float topMargin = 40.0f;
+  static constexpr float rightMargin = 40.0f;
+  static constexpr int numTicks = 10;
+
+  const sf::Font &font;
+  float width, height;
+  double tMin = 0.0, tMax = 1.0, vMin = 0.0, vMax = 1.0;
+
+  std::vector<sf::Text> texts;
+  std::vector<sf::RectangleShape> legendBoxes;
+  StaticGeometry axes;
+  sf::VertexArray ticks{sf::Lines};
+  std::vector<sf::Text> tickLabels;
+
+  void draw(sf::RenderTarget &target, sf::RenderStates states) const override {
+    target.draw(axes, states);
+    target.draw(ticks, states);
+    for (auto &lbl : tickLabels)
+      target.draw(lbl, states);
+    for (auto &text : texts)
+      target.draw(text, states);
+    for (auto &box : legendBoxes)
+      target.draw(box, states);
+  }
+
+  sf::Text makeText(const std::string &label, unsigned int size, float px,
+                    float py) const {
+    sf::Text text(label, font, size);
+    text.setFillColor(sf::Color::White);
+    text.setPosition(px, py);
+    return text;
+  }
+
+public:
+  TimeFrame(const sf::Font &labelFont, sf::Vector2u windowSize)
+      : font(labelFont), width(static_cast<float>(windowSize.x)),
+        height(static_cast<float>(windowSize.y)) {
+    // Assi
+    sf::VertexArray lines(sf::Lines);
+    sf::Vector2f origin(leftMargin, height - bottomMargin);
+    lines.append(sf::Vertex(origin, sf::Color::White));
+    lines.append(sf::Vertex(sf::Vector2f(width - rightMargin, origin.y),
+                            sf::Color::White));
+    lines.append(sf::Vertex(origin, sf::Color::White));
+    lines.append(
+        sf::Vertex(sf::Vector2f(leftMargin, topMargin), sf::Color::White));
+    axes.load(lines);
+
+    // Etichette assi
+    texts.push_back(
+        makeText("Tempo", 14, width / 2.0f - 20.0f, height - 40.0f));
+    sf::Text labelY = makeText("Popolazione", 14, 5.0f,
+                               height / 2.0f + 20.0f); // per non sovrapporsi
+    labelY.setRotation(-90.0f);
+    texts.push_back(labelY);
+
+    // Legenda
+    const char *names[] = {"Prede", "Predatori"};
+    sf::Color colors[] = {sf::Color::Green, sf::Color::Red};
+    for (int i = 0; i < 2; ++i) {
+      float top = 10.0f + 20.0f * static_cast<float>(i);
+      sf::RectangleShape box(sf::Vector2f(10.0f, 10.0f));
+      box.setPosition(width - 80.0f, top);
+      box.setFillColor(colors[i]);
+      legendBoxes.push_back(box);
+      texts.push_back(makeText(names[i], 13, width - 65.0f, top - 3.0f));
+    }
+  }
+
+  float plotWidth() const { return width - leftMargin - rightMargin; }
+  float plotHeight() const { return height - topMargin - bottomMargin; }
+
+  // Posizione nella finestra del punto (t, v); un intervallo nullo viene
+  // disegnato al centro
+  sf::Vector2f toPixel(double t, double v) const {
+    auto normalize = [](double val, double minVal, double maxVal) {
+      return maxVal > minVal ? (val - minVal) / (maxVal - minVal) : 0.5;
+    };
+    return sf::Vector2f(
+        leftMargin + static_cast<float>(normalize(t, tMin, tMax)) * plotWidth(),
+        height - bottomMargin -
+            static_cast<float>(normalize(v, vMin, vMax)) * plotHeight());
+  }
+
+  // Vista che limita il disegno all'area del grafico, con le stesse
+  // coordinate della finestra
+  sf::View plotView() const {
+    sf::FloatRect area(leftMargin, topMargin, plotWidth(), plotHeight());
+    sf::View view(area);
+    view.setViewport(sf::FloatRect(area.left / width, area.top / height,
+                                   area.width / width, area.height / height));
+    return view;
+  }
+
+  // Istante corrispondente alla colonna px della finestra
+  double timeAt(float px) const {
+    return tMin + static_cast<double>((px - leftMargin) / plotWidth()) *
+                      (tMax - tMin);
+  }
+
+  void setRange(double tFirst, double tLast, double vLow, double vHigh) {
+    tMin = tFirst;
+    tMax = tLast;
+    vMin = vLow;
+    vMax = vHigh;
+
+    ticks.clear();
+    tickLabels.clear();
+    float axisY = height - bottomMargin;
+    for (int i = 0; i <= numTicks; ++i) {
+      // Tacca verticale ed etichetta del tempo
+      double val = tMin + i * ((tMax - tMin) / numTicks);
+      float px = toPixel(val, vMin).x;
+      ticks.append(
+          sf::Vertex(sf::Vector2f(px, axisY - 5.0f), sf::Color::White));
+      ticks.append(
+          sf::Vertex(sf::Vector2f(px, axisY + 5.0f), sf::Color::White));
+      tickLabels.push_back(
+          makeText(shortLabel(val), 12, px - 10.0f, axisY + 8.0f));
+
+      // Tacca orizzontale ed etichetta della popolazione
+      val = vMin + i * ((vMax - vMin) / numTicks);
+      float py = toPixel(tMin, val).y;
+      ticks.append(
+          sf::Vertex(sf::Vector2f(leftMargin - 5.0f, py), sf::Color::White));
+      ticks.append(
+          sf::Vertex(sf::Vector2f(leftMargin + 5.0f, py), sf::Color::White));
+      tickLabels.push_back(makeText(shortLabel(val), 12, leftMargin - 45.0f,
+                                    py - 8.0f)); // per non toccare labelY
+    }
+  }
+};
+
+} // namespace
+
 // Funzione helper per etichette brevi (max 3 caratteri, ma la notazione
 // scientifica non viene troncata)
 std::string shortLabel(double val) {
@@ -31,36 +220,66 @@ std::string shortLabel(double val) {
   return s;
 }
 
-// Funzione per disegnare il grafico del punto di equilibrio
-void plotEquilibriumPointGraph(const std::vector<double> &x,
-                               const std::vector<double> &y, double A, double B,
-                               double C, double D) {
-  if (x.empty() || y.empty()) {
-    std::cerr << "[!] Vettori vuoti, impossibile disegnare la figura intorno "
-                 "al punto di equilibrio.\n";
-    return;
-  }
+// Finestra di una PlotSession: ogni grafico disegna il proprio contenuto e
+// gestisce i propri eventi, il ciclo degli eventi e' quello della sessione
+class PlotWindow {
+public:
+  sf::RenderWindow window;
 
-  // Creazione finestra
-  sf::RenderWindow window(sf::VideoMode(800, 800),
-                          "Figura intorno al punto di equilibrio",
-                          sf::Style::Close);
-  window.setFramerateLimit(60);
+  explicit PlotWindow(const std::string &title)
+      : window(sf::VideoMode(800, 800), title, sf::Style::Close) {}
+  virtual ~PlotWindow() = default;
 
-  // Centrare la finestra
-  sf::VideoMode desktop = sf::VideoMode::getDesktopMode();
-  int posX = static_cast<int>((desktop.width - window.getSize().x) / 2);
-  int posY = static_cast<int>((desktop.height - window.getSize().y) / 2);
-  window.setPosition(sf::Vector2i(posX, posY));
-
-  // Caricamento font per etichette
-  sf::Font font;
-  if (!font.loadFromFile("DejaVuSans.ttf")) {
-    std::cerr << "[!] Font non trovato. Inserisci DejaVuSans.ttf nella "
-                 "cartella eseguibile.\n";
-    return;
+  PlotWindow(const PlotWindow &) = delete;
+  PlotWindow &operator=(const PlotWindow &) = delete;
+
+  virtual void redraw() = 0;
+
+  // Eventi propri del grafico (zoom, spostamento): true se il contenuto va
+  // ridisegnato
+  virtual bool handle(const sf::Event &) { return false; }
+
+  // true finche' il contenuto cambia da solo e update va chiamato a
+  // intervalli regolari
+  virtual bool animating() const { return false; }
+
+  // Aggiorna il contenuto: true se va ridisegnato
+  virtual bool update() { return false; }
+};
+
+namespace {
+
+// Grafico del punto di equilibrio: orbita nel piano delle fasi
+class EquilibriumPlot : public PlotWindow {
+private:
+  StaticGeometry axesGeometry;
+  StaticGeometry ticksGeometry;
+  StaticGeometry curveGeometry;
+  sf::CircleShape eqPoint;
+  std::vector<sf::Text> labels;
+
+public:
+  EquilibriumPlot(const sf::Font &font, std::span<const double> x,
+                  std::span<const double> y, double A, double B, double C,
+                  double D);
+
+  void redraw() override {
+    window.clear(sf::Color::Black);
+    window.draw(axesGeometry);
+    window.draw(ticksGeometry);
+    window.draw(curveGeometry);
+    window.draw(eqPoint);
+    for (auto &lbl : labels)
+      window.draw(lbl);
+    window.display();
   }
+};
 
+EquilibriumPlot::EquilibriumPlot(const sf::Font &font,
+                                 std::span<const double> x,
+                                 std::span<const double> y, double A, double B,
+                                 double C, double D)
+    : PlotWindow("Figura intorno al punto di equilibrio") {
   // Trova valori minimi e massimi per normalizzazione
   auto [minXIt, maxXIt] = std::minmax_element(x.begin(), x.end());
   auto [minYIt, maxYIt] = std::minmax_element(y.begin(), y.end());
@@ -71,13 +290,17 @@ void plotEquilibriumPointGraph(const std::vector<double> &x,
   float scaleX = static_cast<float>((800.0 - 2.0 * margin) / (maxX - minX));
   float scaleY = static_cast<float>((800.0 - 2.0 * margin) / (maxY - minY));
 
-  // Creazione curva
-  sf::VertexArray curve(sf::LineStrip, x.size());
-  for (size_t i = 0; i < x.size(); ++i) {
+  // Creazione curva, ridotta ai passaggi tra pixel distinti
+  std::vector<std::size_t> segments =
+      decimatePath(x, y, 1.0 / static_cast<double>(scaleX),
+                   1.0 / static_cast<double>(scaleY));
+  sf::VertexArray curve(sf::Lines, segments.size());
+  for (size_t k = 0; k < segments.size(); ++k) {
+    std::size_t i = segments[k];
     float px = margin + static_cast<float>(x[i] - minX) * scaleX;
     float py = 800.0f - (margin + static_cast<float>(y[i] - minY) * scaleY);
-    curve[i].position = sf::Vector2f(px, py);
-    curve[i].color = sf::Color::Cyan;
+    curve[k].position = sf::Vector2f(px, py);
+    curve[k].color = sf::Color::Cyan;
   }
 
   // Assi cartesiani
@@ -113,7 +336,7 @@ void plotEquilibriumPointGraph(const std::vector<double> &x,
   float px_eq = margin + static_cast<float>(x_eq - minX) * scaleX;
   float py_eq = 800.0f - (margin + static_cast<float>(y_eq - minY) * scaleY);
 
-  sf::CircleShape eqPoint(5.0f);
+  eqPoint.setRadius(5.0f);
   eqPoint.setFillColor(sf::Color::Red);
   eqPoint.setOrigin(5.0f, 5.0f);
   eqPoint.setPosition(px_eq, py_eq);
@@ -124,7 +347,6 @@ void plotEquilibriumPointGraph(const std::vector<double> &x,
 
   // Tacche e unità di misura
   sf::VertexArray ticks(sf::Lines);
-  std::vector<sf::Text> tickLabels;
   int numTicks = 10; // numero di tacche per asse
 
   // Tacche asse X
@@ -140,7 +362,7 @@ void plotEquilibriumPointGraph(const std::vector<double> &x,
     sf::Text t(shortLabel(valX), font, 12);
     t.setFillColor(sf::Color::White);
     t.setPosition(px - 10.0f, xAxisY + 8.0f);
-    tickLabels.push_back(t);
+    labels.push_back(t);
   }
 
   // Tacche asse Y
@@ -156,220 +378,414 @@ void plotEquilibriumPointGraph(const std::vector<double> &x,
     sf::Text t(shortLabel(valY), font, 12);
     t.setFillColor(sf::Color::White);
     t.setPosition(yAxisX - 35.0f, py - 8.0f);
-    tickLabels.push_back(t);
+    labels.push_back(t);
   }
 
-  // Ciclo di rendering
-  while (window.isOpen()) {
-    sf::Event event;
-    while (window.pollEvent(event)) {
-      if (event.type == sf::Event::Closed)
-        window.close();
-    }
+  labels.push_back(labelX);
+  labels.push_back(labelY);
+  labels.push_back(eqLabel);
+  axesGeometry.load(axes);
+  ticksGeometry.load(ticks);
+  curveGeometry.load(curve);
+}
 
+// Andamento temporale di prede e predatori. La rotella del mouse ingrandisce
+// attorno al puntatore, il trascinamento con il tasto sinistro sposta la
+// vista e Home torna all'intera simulazione
+class TimeEvolutionPlot : public PlotWindow {
+private:
+  std::span<const double> t, x, y;
+  std::size_t n;
+
+  // Piramidi min/max costruite una volta: ogni vista costa in proporzione
+  // alle colonne di pixel e non al numero di campioni
+  MinMaxPyramid preyPyramid;
+  MinMaxPyramid predatorPyramid;
+
+  double tFirst, tLast, fullSpan;
+  double tBegin, tEnd; // intervallo visibile
+  double minSpan;      // la vista contiene sempre qualche campione
+
+  TimeFrame frame;
+  std::size_t columns;
+  sf::VertexArray preyCurve{sf::LineStrip};
+  sf::VertexArray predatorCurve{sf::LineStrip};
+
+  bool dragging = false;
+  int dragX = 0;
+
+  void rebuild();
+  void clampView();
+  void zoom(double factor, double tCenter);
+
+public:
+  TimeEvolutionPlot(const sf::Font &font, std::span<const double> times,
+                    std::span<const double> prey,
+                    std::span<const double> predators);
+
+  void redraw() override {
     window.clear(sf::Color::Black);
-    window.draw(axes);
-    window.draw(ticks);
-    window.draw(curve);
-    window.draw(eqPoint);
-    window.draw(labelX);
-    window.draw(labelY);
-    window.draw(eqLabel);
-
-    for (auto &lbl : tickLabels)
-      window.draw(lbl);
+    window.setView(frame.plotView());
+    window.draw(preyCurve);
+    window.draw(predatorCurve);
+    window.setView(window.getDefaultView());
+    window.draw(frame);
     window.display();
   }
+
+  bool handle(const sf::Event &event) override;
+};
+
+TimeEvolutionPlot::TimeEvolutionPlot(const sf::Font &font,
+                                     std::span<const double> times,
+                                     std::span<const double> prey,
+                                     std::span<const double> predators)
+    : PlotWindow("Andamento prede/predatori"),
+      t(times.first(std::min({times.size(), prey.size(), predators.size()}))),
+      x(prey), y(predators), n(t.size()), preyPyramid(t, x),
+      predatorPyramid(t, y), tFirst(t.front()), tLast(t.back()),
+      fullSpan(tLast - tFirst), tBegin(tFirst), tEnd(tLast),
+      minSpan(fullSpan * 8.0 / static_cast<double>(n)),
+      frame(font, window.getSize()),
+      columns(static_cast<std::size_t>(frame.plotWidth())) {
+  rebuild();
 }
 
-// Funzione per disegnare l’andamento temporale di prede e predatori
-void plotTimeEvolution(const std::vector<double> &t,
-                       const std::vector<double> &x,
-                       const std::vector<double> &y) {
-  if (t.empty() || x.empty() || y.empty()) {
-    std::cerr << "[!] Vettori vuoti, impossibile disegnare il grafico.\n";
-    return;
+// Ricostruisce curve e assi per [tBegin, tEnd]; l'asse verticale si adatta ai
+// campioni visibili
+void TimeEvolutionPlot::rebuild() {
+  std::vector<std::size_t> preyIndices =
+      preyPyramid.visible(tBegin, tEnd, columns);
+  std::vector<std::size_t> predatorIndices =
+      predatorPyramid.visible(tBegin, tEnd, columns);
+
+  // Campioni appena fuori dalla vista, perche' le curve raggiungano i bordi
+  auto firstVisible = static_cast<std::size_t>(
+      std::lower_bound(t.begin(), t.end(), tBegin) - t.begin());
+  auto endVisible = static_cast<std::size_t>(
+      std::upper_bound(t.begin(), t.end(), tEnd) - t.begin());
+  std::vector<std::size_t> outside;
+  if (firstVisible > 0)
+    outside.push_back(firstVisible - 1);
+  if (endVisible < n)
+    outside.push_back(endVisible);
+
+  double low = std::numeric_limits<double>::infinity();
+  double high = -low;
+  auto include = [&](const std::vector<std::size_t> &indices,
+                     std::span<const double> v) {
+    for (std::size_t i : indices) {
+      low = std::min(low, v[i]);
+      high = std::max(high, v[i]);
+    }
+  };
+  include(preyIndices, x);
+  include(predatorIndices, y);
+  // Vista tra due campioni: contano quelli ai bordi
+  if (low > high) {
+    include(outside, x);
+    include(outside, y);
   }
+  frame.setRange(tBegin, tEnd, low, high);
+
+  auto fill = [&](sf::VertexArray &curve,
+                  const std::vector<std::size_t> &indices,
+                  std::span<const double> v, sf::Color color) {
+    curve.clear();
+    auto add = [&](std::size_t i) {
+      curve.append(sf::Vertex(frame.toPixel(t[i], v[i]), color));
+    };
+    if (firstVisible > 0)
+      add(firstVisible - 1);
+    for (std::size_t i : indices)
+      add(i);
+    if (endVisible < n)
+      add(endVisible);
+  };
+  fill(preyCurve, preyIndices, x, sf::Color::Green);
+  fill(predatorCurve, predatorIndices, y, sf::Color::Red);
+}
 
-  // Creazione finestra
-  sf::RenderWindow window(sf::VideoMode(800, 800), "Andamento prede/predatori",
-                          sf::Style::Close);
-  window.setFramerateLimit(60);
+// Mantiene la vista dentro la durata della simulazione
+void TimeEvolutionPlot::clampView() {
+  double span = std::min(tEnd - tBegin, fullSpan);
+  tBegin = std::clamp(tBegin, tFirst, tLast - span);
+  tEnd = tBegin + span;
+}
 
-  // Centrare la finestra
-  sf::VideoMode desktop = sf::VideoMode::getDesktopMode();
-  int posX = static_cast<int>((desktop.width - window.getSize().x) / 2);
-  int posY = static_cast<int>((desktop.height - window.getSize().y) / 2);
-  window.setPosition(sf::Vector2i(posX, posY));
-
-  // Caricamento font
-  sf::Font font;
-  if (!font.loadFromFile("DejaVuSans.ttf")) {
-    std::cerr << "[!] Font non trovato.\n";
-    return;
+// Ingrandimento (factor < 1) o riduzione attorno all'istante tCenter
+void TimeEvolutionPlot::zoom(double factor, double tCenter) {
+  double span = tEnd - tBegin;
+  double newSpan = std::clamp(span * factor, minSpan, fullSpan);
+  tBegin = tCenter - (tCenter - tBegin) * (newSpan / span);
+  tEnd = tBegin + newSpan;
+  clampView();
+}
+
+bool TimeEvolutionPlot::handle(const sf::Event &event) {
+  // Un solo istante: niente da ingrandire o spostare
+  if (fullSpan <= 0.0)
+    return false;
+
+  if (event.type == sf::Event::MouseWheelScrolled &&
+      event.mouseWheelScroll.wheel == sf::Mouse::VerticalWheel) {
+    double tCenter = std::clamp(
+        frame.timeAt(static_cast<float>(event.mouseWheelScroll.x)), tBegin,
+        tEnd);
+    zoom(std::pow(0.8, static_cast<double>(event.mouseWheelScroll.delta)),
+         tCenter);
+  } else if (event.type == sf::Event::MouseButtonPressed &&
+             event.mouseButton.button == sf::Mouse::Left) {
+    dragging = true;
+    dragX = event.mouseButton.x;
+    return false;
+  } else if (event.type == sf::Event::MouseButtonReleased &&
+             event.mouseButton.button == sf::Mouse::Left) {
+    dragging = false;
+    return false;
+  } else if (event.type == sf::Event::MouseMoved && dragging) {
+    double shift = static_cast<double>(dragX - event.mouseMove.x) /
+                   static_cast<double>(frame.plotWidth()) * (tEnd - tBegin);
+    dragX = event.mouseMove.x;
+    tBegin += shift;
+    tEnd += shift;
+    clampView();
+  } else if (event.type == sf::Event::KeyPressed &&
+             event.key.code == sf::Keyboard::Home) {
+    tBegin = tFirst;
+    tEnd = tLast;
+  } else {
+    return false;
   }
+  rebuild();
+  return true;
+}
 
-  // Limiti per normalizzazione
-  auto [tMinIt, tMaxIt] = std::minmax_element(t.begin(), t.end());
-  auto [xMinIt, xMaxIt] = std::minmax_element(x.begin(), x.end());
-  auto [yMinIt, yMaxIt] = std::minmax_element(y.begin(), y.end());
-  double tMin = *tMinIt, tMax = *tMaxIt;
-  double xMin = *xMinIt, xMax = *xMaxIt;
-  double yMin = *yMinIt, yMax = *yMaxIt;
-
-  float leftMargin = 70.0f;
-  float bottomMargin = 70.0f;
-  float topMargin = 40.0f;
-  float rightMargin = 40.0f;
-  float plotWidth =
-      static_cast<float>(window.getSize().x) - leftMargin - rightMargin;
-  float plotHeight =
-      static_cast<float>(window.getSize().y) - topMargin - bottomMargin;
-
-  // Funzione lambda per normalizzare un valore
-  auto normalize = [&](double val, double minVal, double maxVal,
-                       float axisSize) {
-    return static_cast<float>((val - minVal) / (maxVal - minVal) * axisSize);
-  };
+// Andamento temporale mentre la simulazione procede su un altro thread
+class LivePlot : public PlotWindow {
+private:
+  LiveSink &source;
+  bool running = true;
+
+  TimeFrame frame;
+  StreamingDecimator prey;
+  StreamingDecimator predators;
+  sf::VertexArray preyCurve{sf::LineStrip};
+  sf::VertexArray predatorCurve{sf::LineStrip};
+
+  void rebuild();
+
+public:
+  // Un intervallo per colonna di pixel, come in decimateMinMax
+  LivePlot(const sf::Font &font, LiveSink &sink)
+      : PlotWindow("Andamento prede/predatori (in corso)"), source(sink),
+        frame(font, window.getSize()),
+        prey(static_cast<std::size_t>(frame.plotWidth())),
+        predators(static_cast<std::size_t>(frame.plotWidth())) {}
+
+  // Finestra chiusa prima della fine: la simulazione continua senza disegno
+  ~LivePlot() override {
+    if (running)
+      source.close();
+  }
 
-  // Curve
-  sf::VertexArray preyCurve(sf::LineStrip, x.size());
-  sf::VertexArray predatorCurve(sf::LineStrip, y.size());
+  void redraw() override {
+    window.clear(sf::Color::Black);
+    window.draw(preyCurve);
+    window.draw(predatorCurve);
+    window.draw(frame);
+    window.display();
+  }
 
-  for (size_t i = 0; i < t.size(); ++i) {
-    float px = leftMargin + normalize(t[i], tMin, tMax, plotWidth);
-    float preyY = static_cast<float>(window.getSize().y) - bottomMargin -
-                  normalize(x[i], xMin, xMax, plotHeight);
-    float predY = static_cast<float>(window.getSize().y) - bottomMargin -
-                  normalize(y[i], yMin, yMax, plotHeight);
+  bool animating() const override { return running; }
+  bool update() override;
+};
+
+// Curve e assi vengono ricostruiti dai punti ridotti, quindi il costo di un
+// aggiornamento non dipende da quanti campioni sono gia' arrivati
+void LivePlot::rebuild() {
+  frame.setRange(prey.tFirst(), prey.tLast(),
+                 std::min(prey.min(), predators.min()),
+                 std::max(prey.max(), predators.max()));
+  auto fill = [&](sf::VertexArray &curve, const StreamingDecimator &decimator,
+                  sf::Color color) {
+    std::vector<StreamingDecimator::Point> points = decimator.points();
+    curve.resize(points.size());
+    for (std::size_t k = 0; k < points.size(); ++k) {
+      curve[k].position = frame.toPixel(points[k].t, points[k].v);
+      curve[k].color = color;
+    }
+  };
+  fill(preyCurve, prey, sf::Color::Green);
+  fill(predatorCurve, predators, sf::Color::Red);
+}
 
-    preyCurve[i].position = sf::Vector2f(px, preyY);
-    preyCurve[i].color = sf::Color::Green;
+// Raccoglie i blocchi gia' pubblicati, senza mai attendere il produttore
+bool LivePlot::update() {
+  bool received = false;
+  running = source.poll([&](const TrajectoryChunk &chunk) {
+    for (std::size_t i = 0; i < chunk.size(); ++i) {
+      prey.push(chunk.t[i], chunk.x[i]);
+      predators.push(chunk.t[i], chunk.y[i]);
+    }
+    received = true;
+  });
+
+  if (!running)
+    window.setTitle("Andamento prede/predatori");
+  if (received)
+    rebuild();
+  return received;
+}
 
-    predatorCurve[i].position = sf::Vector2f(px, predY);
-    predatorCurve[i].color = sf::Color::Red;
+// Gestisce un evento di una finestra: true se va ridisegnata
+bool dispatch(PlotWindow &plot, const sf::Event &event) {
+  if (event.type == sf::Event::Closed) {
+    plot.window.close();
+    return false;
   }
+  return needsRedraw(event) || plot.handle(event);
+}
 
-  // Assi
-  sf::Vertex xAxis[] = {
-      sf::Vertex(sf::Vector2f(
-          leftMargin, static_cast<float>(window.getSize().y) - bottomMargin)),
-      sf::Vertex(
-          sf::Vector2f(static_cast<float>(window.getSize().x) - rightMargin,
-                       static_cast<float>(window.getSize().y) - bottomMargin))};
-  sf::Vertex yAxis[] = {
-      sf::Vertex(sf::Vector2f(
-          leftMargin, static_cast<float>(window.getSize().y) - bottomMargin)),
-      sf::Vertex(sf::Vector2f(leftMargin, topMargin))};
-
-  for (auto &v : xAxis)
-    v.color = sf::Color::White;
-  for (auto &v : yAxis)
-    v.color = sf::Color::White;
-
-  // Etichette assi
-  sf::Text labelX("Tempo", font, 14);
-  labelX.setFillColor(sf::Color::White);
-  labelX.setPosition(static_cast<float>(window.getSize().x) / 2.0f - 20.0f,
-                     static_cast<float>(window.getSize().y) - 40.0f);
+} // namespace
 
-  sf::Text labelY("Popolazione", font, 14);
-  labelY.setFillColor(sf::Color::White);
-  labelY.setRotation(-90.0f);
-  labelY.setPosition(5.0f, static_cast<float>(window.getSize().y) / 2.0f +
-                               20.0f); // spostata per non sovrapporsi
+PlotSession::PlotSession(const std::string &fontPath) {
+  fontLoaded = font.loadFromFile(fontPath);
+  if (!fontLoaded)
+    std::cerr << "[!] Font non trovato. Inserisci " << fontPath
+              << " nella cartella eseguibile.\n";
+}
 
-  // Tacche e unità di misura
-  sf::VertexArray ticks(sf::Lines);
-  std::vector<sf::Text> tickLabels;
-  int numTicks = 10;
+PlotSession::~PlotSession() = default;
 
-  // Tacche asse X
-  for (int i = 0; i <= numTicks; ++i) {
-    double val = tMin + i * ((tMax - tMin) / numTicks);
-    float px = leftMargin + normalize(val, tMin, tMax, plotWidth);
+bool PlotSession::ready() const { return fontLoaded; }
 
-    // Tacca verticale
-    ticks.append(
-        sf::Vertex(sf::Vector2f(px, static_cast<float>(window.getSize().y) -
-                                        bottomMargin - 5.0f),
-                   sf::Color::White));
-    ticks.append(
-        sf::Vertex(sf::Vector2f(px, static_cast<float>(window.getSize().y) -
-                                        bottomMargin + 5.0f),
-                   sf::Color::White));
+void PlotSession::addEquilibriumPlot(std::span<const double> x,
+                                     std::span<const double> y, double A,
+                                     double B, double C, double D) {
+  if (x.empty() || y.empty()) {
+    std::cerr << "[!] Vettori vuoti, impossibile disegnare la figura intorno "
+                 "al punto di equilibrio.\n";
+    return;
+  }
+  if (fontLoaded)
+    windows.push_back(
+        std::make_unique<EquilibriumPlot>(font, x, y, A, B, C, D));
+}
 
-    // Etichetta
-    sf::Text tLabel(shortLabel(val), font, 12);
-    tLabel.setFillColor(sf::Color::White);
-    tLabel.setPosition(px - 10.0f, static_cast<float>(window.getSize().y) -
-                                       bottomMargin + 8.0f);
-    tickLabels.push_back(tLabel);
+void PlotSession::addTimeEvolution(std::span<const double> t,
+                                   std::span<const double> x,
+                                   std::span<const double> y) {
+  if (t.empty() || x.empty() || y.empty()) {
+    std::cerr << "[!] Vettori vuoti, impossibile disegnare il grafico.\n";
+    return;
   }
+  if (fontLoaded)
+    windows.push_back(std::make_unique<TimeEvolutionPlot>(font, t, x, y));
+}
 
-  // Tacche asse Y (basata sulla popolazione massima tra x e y)
-  double yMinTotal = std::min(xMin, yMin);
-  double yMaxTotal = std::max(xMax, yMax);
+// Senza finestra la simulazione deve comunque poter proseguire
+void PlotSession::addLiveEvolution(LiveSink &source) {
+  if (fontLoaded)
+    windows.push_back(std::make_unique<LivePlot>(font, source));
+  else
+    source.close();
+}
 
-  for (int i = 0; i <= numTicks; ++i) {
-    double val = yMinTotal + i * ((yMaxTotal - yMinTotal) / numTicks);
-    float py = static_cast<float>(window.getSize().y) - bottomMargin -
-               normalize(val, yMinTotal, yMaxTotal, plotHeight);
+// Le finestre vengono affiancate e centrate sullo schermo; se non c'e' spazio
+// si sovrappongono in parte
+void PlotSession::arrange() {
+  if (windows.empty())
+    return;
+  sf::VideoMode desktop = sf::VideoMode::getDesktopMode();
+  int count = static_cast<int>(windows.size());
+  int width = static_cast<int>(windows.front()->window.getSize().x);
+  int height = static_cast<int>(windows.front()->window.getSize().y);
+  int screenWidth = static_cast<int>(desktop.width);
+
+  int step = width;
+  if (count > 1 && count * width > screenWidth)
+    step = std::max(0, (screenWidth - width) / (count - 1));
+  int left = std::max(0, (screenWidth - step * (count - 1) - width) / 2);
+  int top = std::max(0, (static_cast<int>(desktop.height) - height) / 2);
+  for (int k = 0; k < count; ++k)
+    windows[static_cast<std::size_t>(k)]->window.setPosition(
+        sf::Vector2i(left + k * step, top));
+}
 
-    // Tacca orizzontale
-    ticks.append(
-        sf::Vertex(sf::Vector2f(leftMargin - 5.0f, py), sf::Color::White));
-    ticks.append(
-        sf::Vertex(sf::Vector2f(leftMargin + 5.0f, py), sf::Color::White));
+// Con una sola finestra statica si attende il prossimo evento senza
+// consumare CPU; altrimenti le finestre vengono servite a turno, e ogni
+// finestra viene ridisegnata al piu' una volta per turno. SFML non permette di
+// attendere gli eventi di piu' finestre insieme e bloccarsi su una sola
+// lascerebbe le altre senza risposta: per questo, finche' nessuna finestra e'
+// animata e non arrivano eventi, la pausa tra i turni raddoppia da 30 fino a
+// 250 ms. A riposo il costo e' di pochi risvegli al secondo, in cambio di un
+// ritardo fino a 250 ms sul primo evento dopo una pausa
+void PlotSession::run() {
+  arrange();
+  for (auto &plot : windows)
+    plot->redraw();
+
+  const sf::Int32 shortPause = 30, longPause = 250;
+  sf::Int32 pause = shortPause;
+  while (!windows.empty()) {
+    if (windows.size() == 1 && !windows.front()->animating()) {
+      PlotWindow &plot = *windows.front();
+      sf::Event event;
+      if (!plot.window.waitEvent(event))
+        break;
+      if (dispatch(plot, event) && plot.window.isOpen())
+        plot.redraw();
+    } else {
+      bool active = false;
+      for (auto &plot : windows) {
+        bool dirty = false;
+        sf::Event event;
+        while (plot->window.isOpen() && plot->window.pollEvent(event)) {
+          dirty = dispatch(*plot, event) || dirty;
+          active = true;
+        }
+        if (plot->window.isOpen() && plot->animating()) {
+          dirty = plot->update() || dirty;
+          active = true;
+        }
+        if (dirty && plot->window.isOpen())
+          plot->redraw();
+      }
+      pause = active ? shortPause : std::min(2 * pause, longPause);
+      sf::sleep(sf::milliseconds(pause));
+    }
 
-    // Etichetta
-    sf::Text yLabelTick(shortLabel(val), font, 12);
-    yLabelTick.setFillColor(sf::Color::White);
-    yLabelTick.setPosition(leftMargin - 45.0f,
-                           py - 8.0f); // posizionata per non toccare labelY
-    tickLabels.push_back(yLabelTick);
+    std::erase_if(windows, [](const std::unique_ptr<PlotWindow> &plot) {
+      return !plot->window.isOpen();
+    });
   }
+  windows.clear();
+}
 
-  // Legenda
-  sf::RectangleShape greenBox(sf::Vector2f(10.0f, 10.0f));
-  greenBox.setPosition(720.0f, 10.0f);
-  greenBox.setFillColor(sf::Color::Green);
-
-  sf::Text labelPrede("Prede", font, 13);
-  labelPrede.setFillColor(sf::Color::White);
-  labelPrede.setPosition(735.0f, 7.0f);
-
-  sf::RectangleShape redBox(sf::Vector2f(10.0f, 10.0f));
-  redBox.setPosition(720.0f, 30.0f);
-  redBox.setFillColor(sf::Color::Red);
-
-  sf::Text labelPredatori("Predatori", font, 13);
-  labelPredatori.setFillColor(sf::Color::White);
-  labelPredatori.setPosition(735.0f, 27.0f);
-
-  // Ciclo di rendering
-  while (window.isOpen()) {
-    sf::Event event;
-    while (window.pollEvent(event)) {
-      if (event.type == sf::Event::Closed)
-        window.close();
-    }
+// Funzione per disegnare il grafico del punto di equilibrio
+void plotEquilibriumPointGraph(std::span<const double> x,
+                               std::span<const double> y, double A, double B,
+                               double C, double D) {
+  PlotSession session;
+  session.addEquilibriumPlot(x, y, A, B, C, D);
+  session.run();
+}
 
-    window.clear(sf::Color::Black);
-    window.draw(preyCurve);
-    window.draw(predatorCurve);
-    window.draw(xAxis, 2, sf::Lines);
-    window.draw(yAxis, 2, sf::Lines);
-    window.draw(ticks);
-    for (auto &lbl : tickLabels)
-      window.draw(lbl);
-    window.draw(labelX);
-    window.draw(labelY);
-    window.draw(greenBox);
-    window.draw(labelPrede);
-    window.draw(redBox);
-    window.draw(labelPredatori);
-    window.display();
-  }
+// Funzione per disegnare l’andamento temporale di prede e predatori
+void plotTimeEvolution(std::span<const double> t,
+                       std::span<const double> x,
+                       std::span<const double> y) {
+  PlotSession session;
+  session.addTimeEvolution(t, x, y);
+  session.run();
+}
+
+// Funzione per disegnare l'andamento temporale mentre la simulazione procede
+void plotLiveEvolution(LiveSink &source) {
+  PlotSession session;
+  session.addLiveEvolution(source);
+  session.run();
 }
+
 } // namespace pf
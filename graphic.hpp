@@ -6,20 +6,79 @@
 #include <cmath>
 #include <iomanip>
 #include <iostream>
+#include <limits>
+#include <memory>
+#include <span>
 #include <sstream>
 #include <string>
 #include <vector>
 
+#include "decimation.hpp"
+#include "trajectory_sink.hpp"
+
 namespace pf {
 std::string shortLabel(double val);
 
-void plotEquilibriumPointGraph(const std::vector<double> &x,
-                               const std::vector<double> &y, double A, double B,
+class PlotWindow;
+
+// Sessione di grafici: possiede le finestre aggiunte e le serve tutte da un
+// unico ciclo degli eventi, cosi' i grafici restano visibili uno accanto
+// all'altro. Il font DejaVuSans.ttf viene caricato una volta per tutte le
+// finestre; se manca, le finestre non vengono aperte
+class PlotSession {
+private:
+  sf::Font font;
+  bool fontLoaded = false;
+  std::vector<std::unique_ptr<PlotWindow>> windows;
+
+  void arrange();
+
+public:
+  explicit PlotSession(const std::string &fontPath = "DejaVuSans.ttf");
+  ~PlotSession();
+
+  PlotSession(const PlotSession &) = delete;
+  PlotSession &operator=(const PlotSession &) = delete;
+
+  // false se il font non e' stato caricato
+  bool ready() const;
+
+  // Orbita nel piano delle fasi attorno al punto di equilibrio
+  void addEquilibriumPlot(std::span<const double> x,
+                          std::span<const double> y, double A, double B,
+                          double C, double D);
+
+  // Andamento temporale: la rotella del mouse ingrandisce attorno al
+  // puntatore, il trascinamento sposta la vista nel tempo e Home torna
+  // all'intera simulazione. I vettori devono restare validi fino alla fine
+  // di run
+  void addTimeEvolution(std::span<const double> t, std::span<const double> x,
+                        std::span<const double> y);
+
+  // Andamento temporale mentre la simulazione procede su un altro thread, che
+  // pubblica i campioni in source (e chiama finish alla fine). Le curve
+  // crescono man mano e gli assi si adattano ai nuovi intervalli. Se la
+  // finestra viene chiusa prima, source.close() lascia proseguire la
+  // simulazione senza disegno
+  void addLiveEvolution(LiveSink &source);
+
+  // Mostra le finestre aggiunte e gestisce i loro eventi finche' non vengono
+  // chiuse tutte
+  void run();
+};
+
+// Le funzioni seguenti aprono una sessione con un solo grafico e attendono
+// che la finestra venga chiusa
+
+void plotEquilibriumPointGraph(std::span<const double> x,
+                               std::span<const double> y, double A, double B,
                                double C, double D);
 
-void plotTimeEvolution(const std::vector<double> &t,
-                       const std::vector<double> &x,
-                       const std::vector<double> &y);
+void plotTimeEvolution(std::span<const double> t,
+                       std::span<const double> x,
+                       std::span<const double> y);
+
+void plotLiveEvolution(LiveSink &source);
 } // namespace pf
 
-#endif
\ No newline at end of file
+#endif
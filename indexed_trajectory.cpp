@@ -0,0 +1,304 @@
+#include "indexed_trajectory.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <filesystem>
+#include <limits>
+#include <stdexcept>
+
+namespace pf {
+
+namespace {
+
+constexpr char indexedMagic[8] = "LVINDX1";
+constexpr double missing = std::numeric_limits<double>::quiet_NaN();
+
+// Coda del file: posizione e lunghezza dell'indice
+struct IndexTrailer {
+  std::uint64_t indexOffset;
+  std::uint64_t blockCount;
+  char magic[8];
+};
+
+// fmin e fmax ignorano i NaN, quindi gli estremi partono da NaN
+TrajectoryBounds emptyBounds() {
+  return {missing, missing, missing, missing, missing, missing};
+}
+
+void merge(TrajectoryBounds &bounds, const TrajectoryBounds &other) {
+  bounds.xMin = std::fmin(bounds.xMin, other.xMin);
+  bounds.xMax = std::fmax(bounds.xMax, other.xMax);
+  bounds.yMin = std::fmin(bounds.yMin, other.yMin);
+  bounds.yMax = std::fmax(bounds.yMax, other.yMax);
+  bounds.HMin = std::fmin(bounds.HMin, other.HMin);
+  bounds.HMax = std::fmax(bounds.HMax, other.HMax);
+}
+
+// Campione m di un blocco; H vale NaN se assente
+TrajectorySample sampleOf(const TrajectoryChunk &chunk, std::size_t m) {
+  return {chunk.t[m], chunk.x[m], chunk.y[m],
+          chunk.H.empty() ? missing : chunk.H[m]};
+}
+
+void merge(TrajectoryBounds &bounds, const TrajectorySample &sample) {
+  merge(bounds, TrajectoryBounds{sample.x, sample.x, sample.y, sample.y,
+                                 sample.H, sample.H});
+}
+
+template <class T> void writeRaw(std::ofstream &out, const T *data,
+                                 std::size_t n) {
+  out.write(reinterpret_cast<const char *>(data),
+            static_cast<std::streamsize>(n * sizeof(T)));
+}
+
+template <class T> void readRaw(std::ifstream &in, T *data, std::size_t n) {
+  in.read(reinterpret_cast<char *>(data),
+          static_cast<std::streamsize>(n * sizeof(T)));
+}
+
+} // namespace
+
+IndexedTrajectoryWriter::IndexedTrajectoryWriter(
+    const std::string &newPath, BinaryTrajectoryHeader newHeader,
+    std::size_t newBlockSize)
+    : out(newPath, std::ios::binary), path(newPath), header(newHeader),
+      blockSize(std::max<std::size_t>(newBlockSize, 1)) {
+  if (!out)
+    throw std::runtime_error("Impossibile aprire " + path);
+  std::memcpy(header.magic, indexedMagic, sizeof indexedMagic);
+  // L'intestazione definitiva, con il numero di campioni, viene riscritta da
+  // close
+  writeRaw(out, &header, 1);
+  pending.reserve(blockSize);
+}
+
+IndexedTrajectoryWriter::~IndexedTrajectoryWriter() {
+  try {
+    close();
+  } catch (...) {
+  }
+}
+
+// H viene salvato se presente nel primo blocco ricevuto
+void IndexedTrajectoryWriter::consume(const TrajectoryChunk &chunk) {
+  if (withH < 0 && !chunk.empty())
+    withH = chunk.H.empty() ? 0 : 1;
+
+  for (std::size_t m = 0; m < chunk.size(); ++m) {
+    if (withH == 1)
+      pending.push(chunk.t[m], chunk.x[m], chunk.y[m],
+                   chunk.H.empty() ? missing : chunk.H[m]);
+    else
+      pending.push(chunk.t[m], chunk.x[m], chunk.y[m]);
+    if (pending.size() == blockSize)
+      writeBlock();
+  }
+}
+
+void IndexedTrajectoryWriter::flush() { out.flush(); }
+
+void IndexedTrajectoryWriter::writeBlock() {
+  if (pending.empty())
+    return;
+
+  TrajectoryBlock block{};
+  block.tFirst = pending.t.front();
+  block.tLast = pending.t.back();
+  block.offset = static_cast<std::uint64_t>(std::streamoff(out.tellp()));
+  block.first = count;
+  block.count = pending.size();
+
+  auto [xMin, xMax] = std::minmax_element(pending.x.begin(), pending.x.end());
+  auto [yMin, yMax] = std::minmax_element(pending.y.begin(), pending.y.end());
+  block.bounds = {*xMin, *xMax, *yMin, *yMax, missing, missing};
+  if (withH == 1) {
+    auto [HMin, HMax] = std::minmax_element(pending.H.begin(), pending.H.end());
+    block.bounds.HMin = *HMin;
+    block.bounds.HMax = *HMax;
+  }
+
+  writeRaw(out, pending.t.data(), pending.size());
+  writeRaw(out, pending.x.data(), pending.size());
+  writeRaw(out, pending.y.data(), pending.size());
+  if (withH == 1)
+    writeRaw(out, pending.H.data(), pending.size());
+
+  index.push_back(block);
+  count += pending.size();
+  pending.clear();
+}
+
+void IndexedTrajectoryWriter::close() {
+  if (!out.is_open())
+    return;
+
+  writeBlock();
+  IndexTrailer trailer{};
+  trailer.indexOffset =
+      static_cast<std::uint64_t>(std::streamoff(out.tellp()));
+  trailer.blockCount = index.size();
+  std::memcpy(trailer.magic, indexedMagic, sizeof indexedMagic);
+  writeRaw(out, index.data(), index.size());
+  writeRaw(out, &trailer, 1);
+
+  header.count = count;
+  header.hasH = withH == 1 ? 1 : 0;
+  out.seekp(0);
+  writeRaw(out, &header, 1);
+  out.close();
+  if (!out)
+    throw std::runtime_error("Impossibile scrivere " + path);
+}
+
+IndexedTrajectory::IndexedTrajectory(const std::string &newPath)
+    : in(newPath, std::ios::binary), path(newPath), fileHeader{} {
+  if (!in)
+    throw std::runtime_error("Impossibile aprire " + path);
+
+  std::error_code error;
+  std::uint64_t fileSize = std::filesystem::file_size(path, error);
+  if (error || fileSize < sizeof fileHeader + sizeof(IndexTrailer))
+    throw std::runtime_error("File indicizzato troncato: " + path);
+
+  readRaw(in, &fileHeader, 1);
+  IndexTrailer trailer{};
+  in.seekg(-static_cast<std::streamoff>(sizeof trailer), std::ios::end);
+  readRaw(in, &trailer, 1);
+  if (!in ||
+      std::memcmp(fileHeader.magic, indexedMagic, sizeof indexedMagic) != 0 ||
+      std::memcmp(trailer.magic, indexedMagic, sizeof indexedMagic) != 0) {
+    throw std::runtime_error("File indicizzato non valido: " + path);
+  }
+
+  // L'indice deve stare tra i blocchi e la coda: i controlli sono scritti in
+  // modo da non traboccare con valori arbitrari
+  std::uint64_t indexEnd = fileSize - sizeof trailer;
+  if (trailer.indexOffset < sizeof fileHeader ||
+      trailer.indexOffset > indexEnd ||
+      trailer.blockCount != (indexEnd - trailer.indexOffset) /
+                                sizeof(TrajectoryBlock) ||
+      (indexEnd - trailer.indexOffset) % sizeof(TrajectoryBlock) != 0)
+    throw std::runtime_error("File indicizzato non valido: " + path);
+
+  index.resize(static_cast<std::size_t>(trailer.blockCount));
+  in.seekg(static_cast<std::streamoff>(trailer.indexOffset));
+  readRaw(in, index.data(), index.size());
+  if (!in)
+    throw std::runtime_error("File indicizzato troncato: " + path);
+
+  // Ogni blocco, non vuoto, deve stare prima dell'indice e i blocchi devono
+  // coprire in ordine tutti i campioni dichiarati nell'intestazione
+  std::uint64_t columns = hasH() ? 4 : 3;
+  std::uint64_t total = 0;
+  for (const TrajectoryBlock &block : index) {
+    if (block.count == 0 || block.first != total ||
+        block.offset < sizeof fileHeader ||
+        block.offset > trailer.indexOffset ||
+        block.count > (trailer.indexOffset - block.offset) /
+                          (columns * sizeof(double)))
+      throw std::runtime_error("File indicizzato non valido: " + path);
+    total += block.count;
+  }
+  if (total != fileHeader.count)
+    throw std::runtime_error("File indicizzato non valido: " + path);
+}
+
+std::size_t IndexedTrajectory::size() const {
+  return static_cast<std::size_t>(fileHeader.count);
+}
+
+TrajectoryChunk IndexedTrajectory::readBlock(std::size_t b) const {
+  auto n = static_cast<std::size_t>(index[b].count);
+  TrajectoryChunk chunk;
+  chunk.t.resize(n);
+  chunk.x.resize(n);
+  chunk.y.resize(n);
+  if (hasH())
+    chunk.H.resize(n);
+
+  in.seekg(static_cast<std::streamoff>(index[b].offset));
+  readRaw(in, chunk.t.data(), n);
+  readRaw(in, chunk.x.data(), n);
+  readRaw(in, chunk.y.data(), n);
+  readRaw(in, chunk.H.data(), chunk.H.size());
+  if (!in)
+    throw std::runtime_error("File indicizzato troncato: " + path);
+  ++reads;
+  return chunk;
+}
+
+// Gli istanti sono crescenti, quindi l'indice e' ordinato
+std::size_t IndexedTrajectory::findBlock(double time) const {
+  auto it = std::partition_point(
+      index.begin(), index.end(),
+      [time](const TrajectoryBlock &block) { return block.tLast < time; });
+  return static_cast<std::size_t>(it - index.begin());
+}
+
+TrajectoryChunk IndexedTrajectory::range(double t1, double t2) const {
+  TrajectoryChunk result;
+  for (std::size_t b = findBlock(t1);
+       b < index.size() && index[b].tFirst <= t2; ++b) {
+    TrajectoryChunk block = readBlock(b);
+    for (std::size_t m = 0; m < block.size(); ++m) {
+      if (block.t[m] < t1 || block.t[m] > t2)
+        continue;
+      if (hasH())
+        result.push(block.t[m], block.x[m], block.y[m], block.H[m]);
+      else
+        result.push(block.t[m], block.x[m], block.y[m]);
+    }
+  }
+  return result;
+}
+
+// Si leggono al piu' due blocchi: quello che contiene time e, se time cade
+// prima del suo primo campione, il precedente
+TrajectorySample IndexedTrajectory::stateAt(double time) const {
+  std::size_t b = findBlock(time);
+  if (index.empty() || b == index.size() || time < index.front().tFirst)
+    throw std::out_of_range("Istante fuori dalla traiettoria");
+
+  TrajectoryChunk block = readBlock(b);
+  auto next = static_cast<std::size_t>(
+      std::upper_bound(block.t.begin(), block.t.end(), time) -
+      block.t.begin());
+
+  TrajectorySample left{}, right{};
+  if (next == 0) {
+    TrajectoryChunk previous = readBlock(b - 1);
+    left = sampleOf(previous, previous.size() - 1);
+    right = sampleOf(block, 0);
+  } else if (next == block.size()) {
+    return sampleOf(block, next - 1);
+  } else {
+    left = sampleOf(block, next - 1);
+    right = sampleOf(block, next);
+  }
+
+  if (time == left.t)
+    return left;
+  double s = (time - left.t) / (right.t - left.t);
+  return {time, left.x + s * (right.x - left.x),
+          left.y + s * (right.y - left.y), left.H + s * (right.H - left.H)};
+}
+
+TrajectoryBounds IndexedTrajectory::extremes(double t1, double t2) const {
+  TrajectoryBounds bounds = emptyBounds();
+  for (std::size_t b = findBlock(t1);
+       b < index.size() && index[b].tFirst <= t2; ++b) {
+    if (index[b].tFirst >= t1 && index[b].tLast <= t2) {
+      merge(bounds, index[b].bounds);
+      continue;
+    }
+    TrajectoryChunk block = readBlock(b);
+    for (std::size_t m = 0; m < block.size(); ++m) {
+      if (block.t[m] >= t1 && block.t[m] <= t2)
+        merge(bounds, sampleOf(block, m));
+    }
+  }
+  return bounds;
+}
+
+} // namespace pf
@@ -0,0 +1,125 @@
+#ifndef INDEXED_TRAJECTORY_HPP
+#define INDEXED_TRAJECTORY_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include "trajectory_io.hpp"
+#include "trajectory_sink.hpp"
+
+namespace pf {
+
+// Formato indicizzato (ValueList.lvi): l'intestazione di trajectory_io.hpp
+// (magic "LVINDX1"), i blocchi di campioni consecutivi, ciascuno con le
+// colonne t, x, y e (se presente) H contigue, poi l'indice dei blocchi e una
+// coda con la posizione dell'indice. Per rispondere a una richiesta su un
+// intervallo di tempo basta leggere l'indice e i blocchi che lo intersecano
+
+// Valori estremi di x, y e H
+struct TrajectoryBounds {
+  double xMin, xMax;
+  double yMin, yMax;
+  double HMin, HMax; // NaN se H non e' presente
+};
+
+// Voce dell'indice: intervallo di tempo, posizione nel file ed estremi di un
+// blocco
+struct TrajectoryBlock {
+  double tFirst, tLast;  // primo e ultimo istante del blocco
+  std::uint64_t offset;  // posizione dei dati nel file, in byte
+  std::uint64_t first;   // indice del primo campione del blocco
+  std::uint64_t count;   // campioni nel blocco
+  TrajectoryBounds bounds;
+};
+
+// Stato della traiettoria in un istante
+struct TrajectorySample {
+  double t, x, y;
+  double H; // NaN se H non e' presente
+};
+
+// Scrive un file indicizzato a partire dai blocchi prodotti da
+// runSimulation in modalita' streaming; la memoria usata e' quella di un
+// blocco. Il file e' completo solo dopo close (chiamata anche dal
+// distruttore): flush non chiude il blocco in corso, cosi' che piu'
+// esecuzioni consecutive finiscano nello stesso file
+class IndexedTrajectoryWriter : public TrajectorySink {
+private:
+  std::ofstream out;
+  std::string path;
+  BinaryTrajectoryHeader header;
+  std::size_t blockSize;
+  TrajectoryChunk pending;
+  std::vector<TrajectoryBlock> index;
+  std::uint64_t count = 0;
+  int withH = -1; // -1 finche' non arriva il primo campione
+
+  void writeBlock();
+
+public:
+  // blockSize e' il numero di campioni per blocco; i parametri della
+  // simulazione vengono copiati da header
+  explicit IndexedTrajectoryWriter(const std::string &newPath,
+                                   BinaryTrajectoryHeader newHeader =
+                                       makeBinaryHeader(),
+                                   std::size_t newBlockSize = 4096);
+  ~IndexedTrajectoryWriter() override;
+
+  IndexedTrajectoryWriter(const IndexedTrajectoryWriter &) = delete;
+  IndexedTrajectoryWriter &operator=(const IndexedTrajectoryWriter &) = delete;
+
+  void consume(const TrajectoryChunk &chunk) override;
+  void flush() override;
+
+  // Scrive l'ultimo blocco, l'indice e l'intestazione definitiva; lancia
+  // std::runtime_error se la scrittura non riesce
+  void close();
+};
+
+// Lettura di un file indicizzato: il costruttore legge solo intestazione e
+// indice, i blocchi vengono letti quando servono. Non e' thread-safe: il file
+// resta aperto e viene letto dai metodi const
+class IndexedTrajectory {
+private:
+  mutable std::ifstream in;
+  std::string path;
+  BinaryTrajectoryHeader fileHeader;
+  std::vector<TrajectoryBlock> index;
+  mutable std::size_t reads = 0;
+
+  TrajectoryChunk readBlock(std::size_t b) const;
+
+  // Primo blocco il cui ultimo istante non precede time
+  std::size_t findBlock(double time) const;
+
+public:
+  // Lancia std::runtime_error se il file non e' valido
+  explicit IndexedTrajectory(const std::string &newPath);
+
+  const BinaryTrajectoryHeader &header() const { return fileHeader; }
+  std::size_t size() const;
+  bool hasH() const { return fileHeader.hasH != 0; }
+  const std::vector<TrajectoryBlock> &blocks() const { return index; }
+
+  // Campioni con t1 <= t <= t2
+  TrajectoryChunk range(double t1, double t2) const;
+
+  // Stato all'istante time, interpolato linearmente tra i due campioni
+  // vicini; lancia std::out_of_range se time e' fuori dalla traiettoria
+  TrajectorySample stateAt(double time) const;
+
+  // Estremi dei campioni con t1 <= t <= t2: i blocchi interamente contenuti
+  // nell'intervallo usano gli estremi dell'indice, senza essere letti. Senza
+  // campioni nell'intervallo gli estremi valgono NaN
+  TrajectoryBounds extremes(double t1, double t2) const;
+
+  // Blocchi letti dal file finora
+  std::size_t blocksRead() const { return reads; }
+};
+
+} // namespace pf
+
+#endif // INDEXED_TRAJECTORY_HPP
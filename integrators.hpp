@@ -0,0 +1,185 @@
+#ifndef INTEGRATORS_HPP
+#define INTEGRATORS_HPP
+
+#include <cmath>
+#include <cstddef>
+#include <limits>
+
+namespace pf {
+
+// Coefficienti del sistema Lotka-Volterra
+struct Coefficients {
+  double A, B, C, D;
+};
+
+// Controllo di estinzione: le popolazioni sotto soglia vengono azzerate.
+// Restituisce true se almeno una specie si e' estinta
+inline bool applyExtinction(double &x, double &y) {
+  bool extinct_x = (x <= 1e-6);
+  bool extinct_y = (y <= 1e-6);
+  if (extinct_x)
+    x = 0.0;
+  if (extinct_y)
+    y = 0.0;
+  return extinct_x || extinct_y;
+}
+
+// Integrale del moto H nello stato (x, y)
+inline double hamiltonian(const Coefficients &k, double x, double y) {
+  return -k.D * std::log(x) + k.C * x + k.B * y - k.A * std::log(y);
+}
+
+// Calcola H per n stati consecutivi in un unico passaggio: in caso di
+// estinzione (popolazione azzerata) H e' infinito
+inline void computeH(const Coefficients &k, const double *x, const double *y,
+                     double *H, std::size_t n) {
+  for (std::size_t i = 0; i < n; ++i) {
+    H[i] = (x[i] <= 0.0 || y[i] <= 0.0)
+               ? std::numeric_limits<double>::infinity()
+               : hamiltonian(k, x[i], y[i]);
+  }
+}
+
+// Metodi a passo fisso usati come parametro di Simulation::run<Stepper>.
+// Ogni metodo fa avanzare lo stato (x, y) di dt e applica il controllo di
+// estinzione; H non viene calcolato qui ma solo quando serve (computeH).
+// Le funzioni sono inline, cosi' il ciclo di run<Stepper> viene specializzato
+// e ottimizzato per intero dal compilatore
+
+// Euler esplicito con la formula relativa al punto di equilibrio e_2
+struct Euler {
+  static constexpr int rhsPerStep = 1;
+
+  static void step(const Coefficients &k, double &x, double &y, double dt) {
+    // Variabili relative rispetto al punto di equilibrio e_2
+    double e2x = k.D / k.C;
+    double e2y = k.A / k.B;
+    double x_rel = x / e2x;
+    double y_rel = y / e2y;
+
+    // Aggiornamento con la formula relativa e conversione alle variabili
+    // assolute
+    x = (x_rel + k.A * (1.0 - y_rel) * x_rel * dt) * e2x;
+    y = (y_rel + k.D * (x_rel - 1.0) * y_rel * dt) * e2y;
+
+    applyExtinction(x, y);
+  }
+};
+
+// Runge-Kutta di ordine 4
+struct RK4 {
+  static constexpr int rhsPerStep = 4;
+
+  static void step(const Coefficients &k, double &x, double &y, double dt) {
+    // Derivate dx/dt e dy/dt del sistema
+    auto dxdt = [&k](double xs, double ys) { return k.A * xs - k.B * xs * ys; };
+    auto dydt = [&k](double xs, double ys) { return k.C * xs * ys - k.D * ys; };
+
+    double k1x = dxdt(x, y);
+    double k1y = dydt(x, y);
+
+    double k2x = dxdt(x + 0.5 * dt * k1x, y + 0.5 * dt * k1y);
+    double k2y = dydt(x + 0.5 * dt * k1x, y + 0.5 * dt * k1y);
+
+    double k3x = dxdt(x + 0.5 * dt * k2x, y + 0.5 * dt * k2y);
+    double k3y = dydt(x + 0.5 * dt * k2x, y + 0.5 * dt * k2y);
+
+    double k4x = dxdt(x + dt * k3x, y + dt * k3y);
+    double k4y = dydt(x + dt * k3x, y + dt * k3y);
+
+    x = x + (dt / 6.0) * (k1x + 2 * k2x + 2 * k3x + k4x);
+    y = y + (dt / 6.0) * (k1y + 2 * k2y + 2 * k3y + k4y);
+
+    applyExtinction(x, y);
+  }
+};
+
+// Splitting simplettico di ordine 4 in coordinate logaritmiche.
+// Con u = ln x, v = ln y il sistema e' hamiltoniano con
+// H(u, v) = (C e^u - D u) + (B e^v - A v), somma di un termine in u e uno in v:
+// ogni sottopasso (u con v fisso, v con u fisso) e' esatto e simplettico, e la
+// composizione di Yoshida di tre passi di Strang da' un metodo di ordine 4 che
+// conserva H a meno di un errore limitato anche con passi grandi.
+// step converte x e y a ogni chiamata; run<Symplectic> mantiene invece u e v
+// tra un passo e l'altro (Coordinates<Symplectic>), senza l'errore di
+// arrotondamento di log ed exp a ogni passo.
+// Un passo calcola 7 esponenziali (4 di u per i sottopassi in v, 3 di v per
+// quelli in u), ciascuno piu' costoso di una valutazione polinomiale del campo
+// di RK4: rhsPerStep li conta come valutazioni
+struct Symplectic {
+  static constexpr int rhsPerStep = 7;
+
+  // Soglia di estinzione di applyExtinction in coordinate logaritmiche
+  static constexpr double logExtinction = -13.815510557964274; // ln(1e-6)
+
+  static void stepLog(const Coefficients &k, double &u, double &v, double dt) {
+    // Pesi della composizione di Yoshida
+    const double w1 = 1.0 / (2.0 - std::cbrt(2.0));
+    const double w0 = -std::cbrt(2.0) * w1;
+    const double sub[3] = {w1 * dt, w0 * dt, w1 * dt};
+
+    // I mezzi passi in v tra due passi di Strang consecutivi vengono uniti
+    v += 0.5 * sub[0] * (k.C * std::exp(u) - k.D);
+    for (int i = 0; i < 3; ++i) {
+      u += sub[i] * (k.A - k.B * std::exp(v));
+      double kick = (i < 2) ? 0.5 * (sub[i] + sub[i + 1]) : 0.5 * sub[i];
+      v += kick * (k.C * std::exp(u) - k.D);
+    }
+
+    // Una specie estinta resta a -infinito, cioe' a popolazione nulla
+    if (u <= logExtinction)
+      u = -std::numeric_limits<double>::infinity();
+    if (v <= logExtinction)
+      v = -std::numeric_limits<double>::infinity();
+  }
+
+  static void step(const Coefficients &k, double &x, double &y, double dt) {
+    double u = std::log(x);
+    double v = std::log(y);
+    stepLog(k, u, v, dt);
+    x = std::exp(u);
+    y = std::exp(v);
+  }
+};
+
+// Coordinate in cui run<Stepper> fa avanzare lo stato. Per default sono x e y;
+// un metodo che integra in altre coordinate specializza il modello, e x e y
+// vengono ricavati solo quando servono (salvataggi, monitor di H, checkpoint,
+// attraversamenti della sezione di Poincare' e fine dell'esecuzione)
+template <class Stepper> struct Coordinates {
+  static void enter(double &, double &) {}
+
+  // Prima coordinata del metodo corrispondente alla popolazione x
+  static double first(double x) { return x; }
+
+  static void leave(double p, double q, double &x, double &y) {
+    x = p;
+    y = q;
+  }
+
+  static void step(const Coefficients &k, double &p, double &q, double dt) {
+    Stepper::step(k, p, q, dt);
+  }
+};
+
+template <> struct Coordinates<Symplectic> {
+  static void enter(double &p, double &q) {
+    p = std::log(p);
+    q = std::log(q);
+  }
+
+  static double first(double x) { return std::log(x); }
+
+  static void leave(double u, double v, double &x, double &y) {
+    x = std::exp(u);
+    y = std::exp(v);
+  }
+
+  static void step(const Coefficients &k, double &u, double &v, double dt) {
+    Symplectic::stepLog(k, u, v, dt);
+  }
+};
+
+} // namespace pf
+
+#endif // INTEGRATORS_HPP
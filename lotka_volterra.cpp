@@ -1,7 +1,237 @@
 #include "lotka_volterra.hpp"
+#include "compressed_trajectory.hpp"
+#include "indexed_trajectory.hpp"
+#include "trajectory_io.hpp"
+
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <limits>
+#include <random>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
 
 namespace pf {
 
+namespace {
+
+constexpr char checkpointMagic[8] = "LVCKPT1";
+
+// Versione del formato, scritta dopo il codice iniziale: un checkpoint di una
+// versione diversa viene rifiutato
+constexpr std::uint32_t checkpointVersion = 4;
+
+// Scrittura e lettura dei campi di un checkpoint, uno per uno: i double cosi'
+// come sono in memoria, gli interi sempre a 64 bit, cosi' che il formato non
+// dipenda dalla disposizione delle strutture o dalla dimensione di int
+template <class T> void put(std::ofstream &out, T value) {
+  static_assert(std::is_arithmetic_v<T> && !std::is_same_v<T, bool>);
+  if constexpr (std::is_floating_point_v<T>) {
+    out.write(reinterpret_cast<const char *>(&value), sizeof value);
+  } else {
+    std::conditional_t<std::is_signed_v<T>, std::int64_t, std::uint64_t> wide =
+        value;
+    out.write(reinterpret_cast<const char *>(&wide), sizeof wide);
+  }
+}
+
+// Un valore fuori dall'intervallo del tipo rende lo stream non valido
+template <class T> void get(std::ifstream &in, T &value) {
+  static_assert(std::is_arithmetic_v<T> && !std::is_same_v<T, bool>);
+  if constexpr (std::is_floating_point_v<T>) {
+    in.read(reinterpret_cast<char *>(&value), sizeof value);
+  } else {
+    std::conditional_t<std::is_signed_v<T>, std::int64_t, std::uint64_t> wide =
+        0;
+    in.read(reinterpret_cast<char *>(&wide), sizeof wide);
+    if (!std::in_range<T>(wide))
+      in.setstate(std::ios::failbit);
+    else
+      value = static_cast<T>(wide);
+  }
+}
+
+// I bool e le enumerazioni occupano un byte; in lettura valgono solo 0 e 1 o
+// i valori fino a last
+void putFlag(std::ofstream &out, bool flag) { out.put(flag ? 1 : 0); }
+
+void getFlag(std::ifstream &in, bool &flag) {
+  int byte = in.get();
+  if (byte != 0 && byte != 1)
+    in.setstate(std::ios::failbit);
+  flag = byte == 1;
+}
+
+template <class Enum> void putEnum(std::ofstream &out, Enum value) {
+  out.put(static_cast<char>(value));
+}
+
+template <class Enum> void getEnum(std::ifstream &in, Enum &value, Enum last) {
+  int byte = in.get();
+  if (byte < 0 || byte > static_cast<int>(last))
+    in.setstate(std::ios::failbit);
+  else
+    value = static_cast<Enum>(byte);
+}
+
+void putStats(std::ofstream &out, const RunningStats &stats) {
+  put(out, stats.min);
+  put(out, stats.max);
+  put(out, stats.average);
+  put(out, stats.m2);
+  put(out, stats.count);
+  put(out, stats.nonFinite);
+}
+
+void getStats(std::ifstream &in, RunningStats &stats) {
+  get(in, stats.min);
+  get(in, stats.max);
+  get(in, stats.average);
+  get(in, stats.m2);
+  get(in, stats.count);
+  get(in, stats.nonFinite);
+}
+
+void putDrift(std::ofstream &out, const DriftReport &report) {
+  put(out, report.H0);
+  put(out, report.maxDeviation);
+  putFlag(out, report.violated);
+  put(out, report.violationStep);
+  put(out, report.violationTime);
+  put(out, report.refinements);
+  put(out, report.dt);
+}
+
+void getDrift(std::ifstream &in, DriftReport &report) {
+  get(in, report.H0);
+  get(in, report.maxDeviation);
+  getFlag(in, report.violated);
+  get(in, report.violationStep);
+  get(in, report.violationTime);
+  get(in, report.refinements);
+  get(in, report.dt);
+}
+
+void putVector(std::ofstream &out, const std::vector<double> &v) {
+  put(out, v.size());
+  out.write(reinterpret_cast<const char *>(v.data()),
+            static_cast<std::streamsize>(v.size() * sizeof(double)));
+}
+
+// La lunghezza letta viene confrontata con i byte rimasti prima di allocare
+void getVector(std::ifstream &in, std::vector<double> &v,
+               std::uint64_t fileSize) {
+  std::size_t size = 0;
+  get(in, size);
+  std::streamoff position = in.tellg();
+  if (!in || position < 0 ||
+      size > (fileSize - static_cast<std::uint64_t>(position)) /
+                 sizeof(double)) {
+    in.setstate(std::ios::failbit);
+    return;
+  }
+  v.resize(size);
+  in.read(reinterpret_cast<char *>(v.data()),
+          static_cast<std::streamsize>(size * sizeof(double)));
+}
+
+// Dopo codice iniziale e versione: identificativo delle colonne, scelto a caso
+// quando vengono riscritte da capo, e numero di valori validi in ciascuna
+struct CheckpointColumns {
+  std::uint64_t id = 0;
+  std::size_t times = 0, samples = 0, H = 0;
+};
+
+void putColumns(std::ofstream &out, const CheckpointColumns &columns) {
+  put(out, columns.id);
+  put(out, columns.times);
+  put(out, columns.samples);
+  put(out, columns.H);
+}
+
+void getColumns(std::ifstream &in, CheckpointColumns &columns) {
+  get(in, columns.id);
+  get(in, columns.times);
+  get(in, columns.samples);
+  get(in, columns.H);
+}
+
+// Legge l'intestazione delle colonne del checkpoint path; false se il file
+// non esiste o non e' un checkpoint di questa versione
+bool readColumns(const std::string &path, CheckpointColumns &columns) {
+  std::ifstream in(path, std::ios::binary);
+  char magic[sizeof checkpointMagic] = {};
+  std::uint32_t version = 0;
+  in.read(magic, sizeof magic);
+  in.read(reinterpret_cast<char *>(&version), sizeof version);
+  if (!in || std::memcmp(magic, checkpointMagic, sizeof magic) != 0 ||
+      version != checkpointVersion)
+    return false;
+  getColumns(in, columns);
+  return static_cast<bool>(in);
+}
+
+std::uint64_t newColumnsId() {
+  std::random_device device;
+  return (std::uint64_t{device()} << 32) ^ device();
+}
+
+// File accanto al checkpoint path con i valori della colonna name
+std::string columnFile(const std::string &path, const char *name) {
+  return path + '.' + name + ".col";
+}
+
+// Porta il file a saved valori e vi aggiunge quelli successivi della colonna
+void appendColumn(const std::string &file, std::span<const double> column,
+                  std::size_t saved) {
+  std::ios::openmode mode = std::ios::binary | std::ios::trunc;
+  if (saved > 0) {
+    std::filesystem::resize_file(file, saved * sizeof(double));
+    mode = std::ios::binary | std::ios::app;
+  }
+  std::ofstream out(file, mode);
+  out.write(reinterpret_cast<const char *>(column.data() + saved),
+            static_cast<std::streamsize>((column.size() - saved) *
+                                         sizeof(double)));
+  out.close();
+  if (!out)
+    throw std::runtime_error("Impossibile scrivere " + file);
+}
+
+// Legge i primi count valori del file nella colonna
+void readColumn(const std::string &file, MappedColumn &column,
+                std::size_t count) {
+  std::error_code error;
+  std::uintmax_t size = std::filesystem::file_size(file, error);
+  std::ifstream in(file, std::ios::binary);
+  if (error || !in || count > size / sizeof(double))
+    throw std::runtime_error("Checkpoint troncato: " + file);
+  column.resize(count);
+  in.read(reinterpret_cast<char *>(column.data()),
+          static_cast<std::streamsize>(count * sizeof(double)));
+  if (!in)
+    throw std::runtime_error("Checkpoint troncato: " + file);
+}
+
+// Polinomio cubico di Hermite tra p0 e p1 (derivate m0 e m1, passo h) nel
+// punto s in [0, 1]
+double hermite(double p0, double m0, double p1, double m1, double h, double s) {
+  double s2 = s * s, s3 = s2 * s;
+  return (2 * s3 - 3 * s2 + 1) * p0 + (s3 - 2 * s2 + s) * h * m0 +
+         (-2 * s3 + 3 * s2) * p1 + (s3 - s2) * h * m1;
+}
+
+// Derivata rispetto a s del polinomio di Hermite
+double hermiteSlope(double p0, double m0, double p1, double m1, double h,
+                    double s) {
+  double s2 = s * s;
+  return (6 * s2 - 6 * s) * p0 + (3 * s2 - 4 * s + 1) * h * m0 +
+         (-6 * s2 + 6 * s) * p1 + (3 * s2 - 2 * s) * h * m1;
+}
+
+} // namespace
+
 // Costruttore con parametri iniziali per i coefficienti e condizioni iniziali
 Simulation::Simulation(double newA, double newB, double newC, double newD,
                        double newx_0, double newy_0, double new_dt)
@@ -9,16 +239,383 @@ Simulation::Simulation(double newA, double newB, double newC, double newD,
 }
 
 // Imposta se utilizzare il metodo Runge-Kutta 4 (RK4) per l'evoluzione
-void Simulation::setUseRK4(bool flag) { useRK4 = flag; }
+void Simulation::setUseRK4(bool flag) {
+  setMethod(flag ? Method::RK4 : Method::Euler);
+}
+
+// Imposta il metodo di integrazione
+void Simulation::setMethod(Method newMethod) {
+  method = newMethod;
+  // Un ciclo calcolato con un altro metodo non e' piu' valido
+  period = 0.0;
+  cycleX.clear();
+  cycleY.clear();
+}
+
+// Restituisce il metodo di integrazione in uso
+Method Simulation::getMethod() const { return method; }
+
+// Imposta le tolleranze del metodo adattivo
+void Simulation::setTolerances(double newAbsTol, double newRelTol) {
+  absTol = newAbsTol;
+  relTol = newRelTol;
+}
+
+// Numero di valutazioni del lato destro effettuate finora
+long long Simulation::getRhsEvaluations() const { return rhsEvaluations; }
+
+// Imposta ogni quanti passi salvare uno stato
+void Simulation::setRecordStride(std::size_t stride) {
+  recordStride = std::max<std::size_t>(stride, 1);
+  stepsSinceRecord = 0;
+}
+
+// Converte l'intervallo di uscita in un numero di passi
+void Simulation::setOutputInterval(double interval) {
+  double steps = std::round(interval / dt);
+  setRecordStride(steps < 1.0 ? 1 : static_cast<std::size_t>(steps));
+}
+
+std::size_t Simulation::getRecordStride() const { return recordStride; }
+
+// Attiva l'avanzamento rapido periodico e azzera il rilevamento dell'orbita
+void Simulation::setPeriodicFastForward(bool flag, double tolerance) {
+  periodicFastForward = flag;
+  closureTolerance = tolerance;
+  period = 0.0;
+  cycleX.clear();
+  cycleY.clear();
+}
+
+double Simulation::getPeriod() const { return period; }
+
+// Attiva il monitor della deriva di H, con H0 calcolato nello stato corrente
+void Simulation::setDriftMonitor(bool flag, double tolerance,
+                                 DriftAction action, int refinements) {
+  monitorDrift = flag;
+  driftTolerance = tolerance;
+  driftAction = action;
+  maxRefinements = std::max(refinements, 0);
+  drift = DriftReport{};
+  drift.H0 = hamiltonian(Coefficients{A, B, C, D}, x_0, y_0);
+  drift.dt = dt;
+}
+
+const DriftReport &Simulation::getDriftReport() const { return drift; }
+
+long long Simulation::getStepCount() const { return stepCount; }
+
+// I campi vengono scritti sempre nello stesso ordine in cui loadCheckpoint li
+// legge. Le colonne vengono estese solo se il checkpoint su path e' l'ultimo
+// scritto da questo oggetto (stesso identificativo e stessi conteggi) e i
+// file contengono ancora i valori gia' salvati. Altrimenti, ad esempio se un
+// altro oggetto o processo ha scritto sullo stesso percorso, il vecchio
+// checkpoint viene rimosso e le colonne riscritte da capo con un nuovo
+// identificativo, perche' non ne resti uno che si riferisce a valori cambiati
+void Simulation::saveCheckpoint(const std::string &path) const {
+  const std::string tFile = columnFile(path, "t"), xFile = columnFile(path, "x"),
+                    yFile = columnFile(path, "y"), HFile = columnFile(path, "H");
+  auto holds = [](const std::string &file, std::size_t saved,
+                  std::size_t size) {
+    std::error_code error;
+    std::uintmax_t bytes = std::filesystem::file_size(file, error);
+    return saved <= size && !error && bytes / sizeof(double) >= saved;
+  };
+  CheckpointColumns previous;
+  bool owned = savedPath == path && readColumns(path, previous) &&
+               previous.id == savedId && previous.times == savedTimes &&
+               previous.samples == savedSamples && previous.H == savedH;
+  if (!owned || !holds(tFile, savedTimes, t.size()) ||
+      !holds(xFile, savedSamples, data.x.size()) ||
+      !holds(yFile, savedSamples, data.y.size()) ||
+      !holds(HFile, savedH, data.H.size())) {
+    std::remove(path.c_str());
+    savedPath.clear();
+    savedId = newColumnsId();
+    savedTimes = savedSamples = savedH = 0;
+  }
+  appendColumn(tFile, t.span(), savedTimes);
+  appendColumn(xFile, data.x.span(), savedSamples);
+  appendColumn(yFile, data.y.span(), savedSamples);
+  appendColumn(HFile, data.H.span(), savedH);
+
+  std::string temporary = path + ".tmp";
+  std::ofstream out(temporary, std::ios::binary);
+  out.write(checkpointMagic, sizeof checkpointMagic);
+  out.write(reinterpret_cast<const char *>(&checkpointVersion),
+            sizeof checkpointVersion);
+  putColumns(out, {savedId, t.size(), data.x.size(), data.H.size()});
+
+  put(out, A);
+  put(out, B);
+  put(out, C);
+  put(out, D);
+  put(out, x_0);
+  put(out, y_0);
+  put(out, dt);
+  putEnum(out, method);
+  put(out, absTol);
+  put(out, relTol);
+  put(out, h_next);
+  put(out, fsal_x);
+  put(out, fsal_y);
+  put(out, fsal_dxdt);
+  put(out, fsal_dydt);
+  putFlag(out, fsalValid);
+  put(out, currentTime);
+  put(out, rhsEvaluations);
+  put(out, recordStride);
+  put(out, stepsSinceRecord);
+
+  putFlag(out, periodicFastForward);
+  put(out, closureTolerance);
+  put(out, period);
+  put(out, crossingTime);
+  put(out, crossingY);
+  putVector(out, cycleX);
+  putVector(out, cycleY);
+  put(out, cycleStart);
+
+  put(out, stepCount);
+  putFlag(out, monitorDrift);
+  put(out, driftTolerance);
+  putEnum(out, driftAction);
+  put(out, maxRefinements);
+  putDrift(out, drift);
+
+  put(out, runOrigin);
+  put(out, runEnd);
+  put(out, runLength);
+  put(out, runDone);
+  put(out, coordP);
+  put(out, coordQ);
+  put(out, checkpointInterval);
+
+  putFlag(out, computeHEnabled);
+  putStats(out, statsx);
+  putStats(out, statsy);
+  putStats(out, statsH);
+
+  out.close();
+  if (!out || std::rename(temporary.c_str(), path.c_str()) != 0)
+    throw std::runtime_error("Impossibile scrivere il checkpoint " + path);
+
+  savedPath = path;
+  savedTimes = t.size();
+  savedSamples = data.x.size();
+  savedH = data.H.size();
+}
+
+// Lo stato viene letto in una copia e sostituito solo se il file e' valido
+void Simulation::loadCheckpoint(const std::string &path) {
+  std::error_code error;
+  std::uintmax_t fileSize = std::filesystem::file_size(path, error);
+  std::ifstream in(path, std::ios::binary);
+  if (error || !in)
+    throw std::runtime_error("Impossibile aprire " + path);
+
+  char magic[sizeof checkpointMagic] = {};
+  in.read(magic, sizeof magic);
+  if (!in || std::memcmp(magic, checkpointMagic, sizeof magic) != 0)
+    throw std::runtime_error("Checkpoint non valido: " + path);
+  std::uint32_t version = 0;
+  in.read(reinterpret_cast<char *>(&version), sizeof version);
+  if (!in || version != checkpointVersion)
+    throw std::runtime_error("Versione del checkpoint non supportata: " +
+                             path);
+  CheckpointColumns columns;
+  getColumns(in, columns);
+
+  // I dati salvati non vengono copiati in loaded: sono comunque sostituiti
+  Data storage = std::move(data);
+  MappedColumn times = std::move(t);
+  Simulation loaded(*this);
+  data = std::move(storage);
+  t = std::move(times);
+
+  get(in, loaded.A);
+  get(in, loaded.B);
+  get(in, loaded.C);
+  get(in, loaded.D);
+  get(in, loaded.x_0);
+  get(in, loaded.y_0);
+  get(in, loaded.dt);
+  getEnum(in, loaded.method, Method::Symplectic);
+  get(in, loaded.absTol);
+  get(in, loaded.relTol);
+  get(in, loaded.h_next);
+  get(in, loaded.fsal_x);
+  get(in, loaded.fsal_y);
+  get(in, loaded.fsal_dxdt);
+  get(in, loaded.fsal_dydt);
+  getFlag(in, loaded.fsalValid);
+  get(in, loaded.currentTime);
+  get(in, loaded.rhsEvaluations);
+  get(in, loaded.recordStride);
+  get(in, loaded.stepsSinceRecord);
+
+  getFlag(in, loaded.periodicFastForward);
+  get(in, loaded.closureTolerance);
+  get(in, loaded.period);
+  get(in, loaded.crossingTime);
+  get(in, loaded.crossingY);
+  getVector(in, loaded.cycleX, fileSize);
+  getVector(in, loaded.cycleY, fileSize);
+  get(in, loaded.cycleStart);
+
+  get(in, loaded.stepCount);
+  getFlag(in, loaded.monitorDrift);
+  get(in, loaded.driftTolerance);
+  getEnum(in, loaded.driftAction, DriftAction::Refine);
+  get(in, loaded.maxRefinements);
+  getDrift(in, loaded.drift);
+
+  get(in, loaded.runOrigin);
+  get(in, loaded.runEnd);
+  get(in, loaded.runLength);
+  get(in, loaded.runDone);
+  get(in, loaded.coordP);
+  get(in, loaded.coordQ);
+  get(in, loaded.checkpointInterval);
+
+  getFlag(in, loaded.computeHEnabled);
+  getStats(in, loaded.statsx);
+  getStats(in, loaded.statsy);
+  getStats(in, loaded.statsH);
+
+  if (!in || loaded.recordStride == 0 || columns.H > columns.samples)
+    throw std::runtime_error("Checkpoint troncato o non valido: " + path);
+
+  readColumn(columnFile(path, "t"), loaded.t, columns.times);
+  readColumn(columnFile(path, "x"), loaded.data.x, columns.samples);
+  readColumn(columnFile(path, "y"), loaded.data.y, columns.samples);
+  readColumn(columnFile(path, "H"), loaded.data.H, columns.H);
+
+  // Il percorso dei checkpoint periodici e' un'impostazione locale
+  loaded.checkpointPath = checkpointPath;
+  loaded.flushPending = nullptr;
+  loaded.savedPath = path;
+  loaded.savedId = columns.id;
+  loaded.savedTimes = columns.times;
+  loaded.savedSamples = columns.samples;
+  loaded.savedH = columns.H;
+
+  // I valori letti vengono copiati nelle colonne attuali, che restano mappate
+  // su file se lo erano
+  data.x = loaded.data.x;
+  data.y = loaded.data.y;
+  data.H = loaded.data.H;
+  t = loaded.t;
+  loaded.data = std::move(data);
+  loaded.t = std::move(t);
+  *this = std::move(loaded);
+}
+
+void Simulation::setCheckpointInterval(long long interval,
+                                       const std::string &path) {
+  checkpointInterval = std::max(interval, 0LL);
+  checkpointPath = path;
+}
+
+// Il checkpoint registra che i passi fino a i sono stati effettuati
+void Simulation::periodicCheckpoint(int i) {
+  runDone = i;
+  if (flushPending)
+    flushPending();
+  saveCheckpoint(checkpointPath);
+}
+
+void Simulation::resumeSimulation() { continueStored(); }
+
+void Simulation::resumeSimulation(TrajectorySink &sink, std::size_t chunkSize) {
+  stream(sink, chunkSize, false);
+}
+
+// Gli stati estinti (H infinito) non sono considerati deriva numerica
+bool Simulation::driftExceeded() {
+  double Hval = hamiltonian(Coefficients{A, B, C, D}, x_0, y_0);
+  if (!std::isfinite(Hval))
+    return false;
+
+  double deviation = std::fabs(Hval - drift.H0) / std::fabs(drift.H0);
+  drift.maxDeviation = std::max(drift.maxDeviation, deviation);
+  if (deviation <= driftTolerance || drift.violated)
+    return false;
+
+  drift.violated = true;
+  drift.violationStep = stepCount;
+  drift.violationTime = currentTime;
+  return driftAction != DriftAction::Report;
+}
+
+// Ogni colonna viene sostituita da una nuova con gli stessi valori; quella
+// vecchia, distrutta, chiude il proprio file
+void Simulation::setMappedStorage(const std::string &prefix) {
+  auto remap = [&prefix](MappedColumn &column, const char *name) {
+    if (!prefix.empty() && column.path() == prefix + name)
+      return;
+    MappedColumn moved =
+        prefix.empty() ? MappedColumn() : MappedColumn(prefix + name);
+    moved = column;
+    column = std::move(moved);
+  };
+  remap(t, "t.col");
+  remap(data.x, "x.col");
+  remap(data.y, "y.col");
+  remap(data.H, "H.col");
+}
 
 // Getter per il vettore dei tempi
-const std::vector<double> &Simulation::gett() const { return t; }
+std::span<const double> Simulation::gett() const { return t.span(); }
 // Getter per il vettore delle popolazioni delle prede
-const std::vector<double> &Simulation::getx() const { return data.x; }
+std::span<const double> Simulation::getx() const { return data.x.span(); }
 // Getter per il vettore delle popolazioni dei predatori
-const std::vector<double> &Simulation::gety() const { return data.y; }
+std::span<const double> Simulation::gety() const { return data.y.span(); }
 // Getter per il vettore dell'integrale primo
-const std::vector<double> &Simulation::getH() const { return data.H; }
+std::span<const double> Simulation::getH() const {
+  materializeH();
+  return data.H.span();
+}
+
+// Attiva o disattiva il calcolo di H; se disattivato i valori gia' calcolati
+// vengono scartati
+void Simulation::setComputeH(bool flag) {
+  computeHEnabled = flag;
+  if (!flag) {
+    data.H.clear();
+    statsH.reset();
+  }
+}
+
+void Simulation::setKeepStreamedData(bool flag) { keepStreamed = flag; }
+
+const RunningStats &Simulation::getxStatistics() const { return statsx; }
+const RunningStats &Simulation::getyStatistics() const { return statsy; }
+const RunningStats &Simulation::getHStatistics() const {
+  materializeH();
+  return statsH;
+}
+
+// Calcola H per i soli stati nuovi: e' infinito in caso di estinzione
+void Simulation::materializeH() const {
+  if (!computeHEnabled || data.H.size() >= data.x.size())
+    return;
+
+  std::size_t first = data.H.size();
+  data.H.resize(data.x.size());
+  computeH(Coefficients{A, B, C, D}, data.x.data() + first,
+           data.y.data() + first, data.H.data() + first, data.x.size() - first);
+  for (std::size_t i = first; i < data.H.size(); ++i)
+    statsH.push(data.H[i]);
+}
+
+// Salva un nuovo stato e aggiorna le statistiche
+void Simulation::store(double xi, double yi) {
+  data.x.push_back(xi);
+  data.y.push_back(yi);
+  statsx.push(xi);
+  statsy.push(yi);
+}
 
 // Calcola la coordinata x del punto di equilibrio e_2 (preda)
 double Simulation::e2_x() const { return D / C; }
@@ -27,8 +624,8 @@ double Simulation::e2_x() const { return D / C; }
 double Simulation::e2_y() const { return A / B; }
 
 // Scrive le coordinate del punto di equilibrio e_2 in un file di testo
-void Simulation::writeCoordinates() const {
-  std::ofstream File("e_2Coordinates.txt");
+void Simulation::writeCoordinates(const std::string &path) const {
+  std::ofstream File(path);
   File << e2_x() << std::endl << e2_y() << std::endl;
   File.close();
 }
@@ -36,180 +633,735 @@ void Simulation::writeCoordinates() const {
 // Inizializza i vettori delle popolazioni, della funzione H e del tempo con i
 // valori iniziali
 void Simulation::initializeVectors() {
-  data.x.push_back(x_0);
-  data.y.push_back(y_0);
-  // Calcolo iniziale della funzione H (integrale del moto)
-  data.H.push_back(-D * log(x_0) + C * x_0 + B * y_0 - A * log(y_0));
+  store(x_0, y_0);
+  // La funzione H (integrale del moto) viene calcolata alla prima richiesta
   t.push_back(0.0);
 }
 
+// Calcola un passo con il metodo indicato e salva i nuovi valori di x e y
+// (H viene calcolato alla prima richiesta)
+template <class Stepper> void Simulation::advance() {
+  Stepper::step(Coefficients{A, B, C, D}, x_0, y_0, dt);
+  rhsEvaluations += Stepper::rhsPerStep;
+  ++stepCount;
+
+  store(x_0, y_0);
+}
+
 // Calcola i nuovi valori di x, y e H dopo un intervallo dt usando la formula
 // semplificata
-void Simulation::evolve() {
-  // Variabili relative rispetto al punto di equilibrio e_2
-  double x_0_rel = x_0 / e2_x();
-  double y_0_rel = y_0 / e2_y();
-
-  // Aggiornamento con la formula relativa (Euler esplicito)
-  double x_i_rel = x_0_rel + A * (1.0 - y_0_rel) * x_0_rel * dt;
-  double y_i_rel = y_0_rel + D * (x_0_rel - 1.0) * y_0_rel * dt;
-
-  // Conversione alle variabili assolute
-  double x_i = x_i_rel * e2_x();
-  double y_i = y_i_rel * e2_y();
-
-  // Se sotto soglia → estinzione
-  bool extinct_x = (x_i <= 1e-6);
-  bool extinct_y = (y_i <= 1e-6);
-  if (extinct_x)
-    x_i = 0.0;
-  if (extinct_y)
-    y_i = 0.0;
-
-  // Calcolo H: in caso di estinzione è infinito
-  double H_i;
-  if (extinct_x || extinct_y) {
-    H_i = std::numeric_limits<double>::infinity(); 
-  } else {
-    H_i = -D * std::log(x_i) + C * x_i + B * y_i - A * std::log(y_i);
-  }
+void Simulation::evolve() { advance<Euler>(); }
 
-  // Salvataggio dei nuovi dati
-  data.x.push_back(x_i);
-  data.y.push_back(y_i);
-  data.H.push_back(H_i);
+// Calcola i nuovi valori di x, y e H con il metodo Runge-Kutta 4
+void Simulation::evolveRK4() { advance<RK4>(); }
 
-  // Aggiornamento stato
-  x_0 = x_i;
-  y_0 = y_i;
+// Calcola i nuovi valori di x, y e H con lo splitting simplettico
+void Simulation::evolveSymplectic() { advance<Symplectic>(); }
+
+// Calcola un passo adattivo con il metodo di Dormand-Prince 5(4): il passo
+// viene ripetuto con ampiezza minore finche' l'errore stimato non rientra nelle
+// tolleranze, e il passo successivo viene adattato di conseguenza
+double Simulation::evolveDP5(double maxStep) {
+  double h = stepDP5(maxStep);
+  ++stepCount;
+
+  // Salvataggio dei dati
+  store(x_0, y_0);
+  return h;
 }
 
-void Simulation::evolveRK4() {
-  // Definizione delle derivate dx/dt e dy/dt per il sistema di equazioni
+// Passo adattivo di Dormand-Prince senza salvataggio: aggiorna lo stato e
+// restituisce l'ampiezza del passo
+double Simulation::stepDP5(double maxStep) {
   auto dxdt = [this](double x, double y) { return A * x - B * x * y; };
   auto dydt = [this](double x, double y) { return C * x * y - D * y; };
 
-  // Calcolo dei coefficienti k1
-  double k1x = dxdt(x_0, y_0);
-  double k1y = dydt(x_0, y_0);
-
-  // Calcolo dei coefficienti k2
-  double k2x = dxdt(x_0 + 0.5 * dt * k1x, y_0 + 0.5 * dt * k1y);
-  double k2y = dydt(x_0 + 0.5 * dt * k1x, y_0 + 0.5 * dt * k1y);
-
-  // Calcolo dei coefficienti k3
-  double k3x = dxdt(x_0 + 0.5 * dt * k2x, y_0 + 0.5 * dt * k2y);
-  double k3y = dydt(x_0 + 0.5 * dt * k2x, y_0 + 0.5 * dt * k2y);
-
-  // Calcolo dei coefficienti k4
-  double k4x = dxdt(x_0 + dt * k3x, y_0 + dt * k3y);
-  double k4y = dydt(x_0 + dt * k3x, y_0 + dt * k3y);
-
-  // Calcolo dei nuovi valori di x e y con la formula RK4
-  double x_next = x_0 + (dt / 6.0) * (k1x + 2 * k2x + 2 * k3x + k4x);
-  double y_next = y_0 + (dt / 6.0) * (k1y + 2 * k2y + 2 * k3y + k4y);
-
-  // Controllo di estinzione
-  bool extinct_x = (x_next <= 1e-6);
-  bool extinct_y = (y_next <= 1e-6);
-  if (extinct_x)
-    x_next = 0.0;
-  if (extinct_y)
-    y_next = 0.0;
-
-  // Calcolo del valore di H
-  double H_next;
-  if (extinct_x || extinct_y) {
-    H_next = std::numeric_limits<double>::infinity(); 
+  // Coefficienti del tableau di Dormand-Prince
+  constexpr double a21 = 1.0 / 5.0;
+  constexpr double a31 = 3.0 / 40.0, a32 = 9.0 / 40.0;
+  constexpr double a41 = 44.0 / 45.0, a42 = -56.0 / 15.0, a43 = 32.0 / 9.0;
+  constexpr double a51 = 19372.0 / 6561.0, a52 = -25360.0 / 2187.0,
+                   a53 = 64448.0 / 6561.0, a54 = -212.0 / 729.0;
+  constexpr double a61 = 9017.0 / 3168.0, a62 = -355.0 / 33.0,
+                   a63 = 46732.0 / 5247.0, a64 = 49.0 / 176.0,
+                   a65 = -5103.0 / 18656.0;
+  // Pesi della soluzione di ordine 5 (coincidono con la riga 7 del tableau)
+  constexpr double b1 = 35.0 / 384.0, b3 = 500.0 / 1113.0,
+                   b4 = 125.0 / 192.0, b5 = -2187.0 / 6784.0,
+                   b6 = 11.0 / 84.0;
+  // Differenza tra i pesi di ordine 5 e di ordine 4 (stima dell'errore)
+  constexpr double e1 = 71.0 / 57600.0, e3 = -71.0 / 16695.0,
+                   e4 = 71.0 / 1920.0, e5 = -17253.0 / 339200.0,
+                   e6 = 22.0 / 525.0, e7 = -1.0 / 40.0;
+
+  double h = h_next > 0.0 ? h_next : dt;
+
+  // k1: riusa l'ultima valutazione del passo precedente se lo stato e' lo
+  // stesso (FSAL), altrimenti la calcola
+  double k1x, k1y;
+  if (fsalValid && fsal_x == x_0 && fsal_y == y_0) {
+    k1x = fsal_dxdt;
+    k1y = fsal_dydt;
   } else {
-    H_next =
-        -D * std::log(x_next) + C * x_next + B * y_next - A * std::log(y_next);
+    k1x = dxdt(x_0, y_0);
+    k1y = dydt(x_0, y_0);
+    ++rhsEvaluations;
   }
 
-  // Salvataggio dei dati
-  data.x.push_back(x_next);
-  data.y.push_back(y_next);
-  data.H.push_back(H_next);
+  while (true) {
+    bool lastStep = h >= maxStep;
+    if (lastStep)
+      h = maxStep;
+
+    double xs = x_0 + h * a21 * k1x;
+    double ys = y_0 + h * a21 * k1y;
+    double k2x = dxdt(xs, ys), k2y = dydt(xs, ys);
+
+    xs = x_0 + h * (a31 * k1x + a32 * k2x);
+    ys = y_0 + h * (a31 * k1y + a32 * k2y);
+    double k3x = dxdt(xs, ys), k3y = dydt(xs, ys);
+
+    xs = x_0 + h * (a41 * k1x + a42 * k2x + a43 * k3x);
+    ys = y_0 + h * (a41 * k1y + a42 * k2y + a43 * k3y);
+    double k4x = dxdt(xs, ys), k4y = dydt(xs, ys);
+
+    xs = x_0 + h * (a51 * k1x + a52 * k2x + a53 * k3x + a54 * k4x);
+    ys = y_0 + h * (a51 * k1y + a52 * k2y + a53 * k3y + a54 * k4y);
+    double k5x = dxdt(xs, ys), k5y = dydt(xs, ys);
+
+    xs = x_0 + h * (a61 * k1x + a62 * k2x + a63 * k3x + a64 * k4x + a65 * k5x);
+    ys = y_0 + h * (a61 * k1y + a62 * k2y + a63 * k3y + a64 * k4y + a65 * k5y);
+    double k6x = dxdt(xs, ys), k6y = dydt(xs, ys);
+
+    double x_next =
+        x_0 + h * (b1 * k1x + b3 * k3x + b4 * k4x + b5 * k5x + b6 * k6x);
+    double y_next =
+        y_0 + h * (b1 * k1y + b3 * k3y + b4 * k4y + b5 * k5y + b6 * k6y);
+    double k7x = dxdt(x_next, y_next), k7y = dydt(x_next, y_next);
+    rhsEvaluations += 6;
+
+    // Stima dell'errore locale, pesata con le tolleranze
+    double err_x = h * (e1 * k1x + e3 * k3x + e4 * k4x + e5 * k5x + e6 * k6x +
+                        e7 * k7x);
+    double err_y = h * (e1 * k1y + e3 * k3y + e4 * k4y + e5 * k5y + e6 * k6y +
+                        e7 * k7y);
+    double sc_x = absTol + relTol * std::max(std::fabs(x_0), std::fabs(x_next));
+    double sc_y = absTol + relTol * std::max(std::fabs(y_0), std::fabs(y_next));
+    double err = std::sqrt(0.5 * ((err_x / sc_x) * (err_x / sc_x) +
+                                  (err_y / sc_y) * (err_y / sc_y)));
+
+    // Nuovo passo proposto, con fattori di sicurezza e limiti standard
+    double factor =
+        err > 0.0 ? std::clamp(0.9 * std::pow(err, -0.2), 0.2, 5.0) : 5.0;
+
+    // Passo rifiutato: si riprova con un passo piu' piccolo (se non e' gia'
+    // al limite della precisione di macchina)
+    if (err > 1.0 && h > 1e-12) {
+      h *= factor;
+      continue;
+    }
+
+    if (!lastStep)
+      h_next = h * factor;
+
+    // Controllo di estinzione
+    bool extinct = applyExtinction(x_next, y_next);
+
+    // Derivate nel nuovo stato, riusate dal passo successivo
+    fsal_x = x_next;
+    fsal_y = y_next;
+    fsal_dxdt = k7x;
+    fsal_dydt = k7y;
+    fsalValid = !extinct;
+
+    x_0 = x_next;
+    y_0 = y_next;
+    return h;
+  }
+}
+
+// Ciclo di n passi con un metodo a passo fisso scelto a tempo di compilazione:
+// il ciclo non contiene scelte a runtime e il passo viene espanso inline.
+// Uno stato ogni recordStride passi (t, x, y) viene passato a record
+template <class Stepper, class Record>
+void Simulation::fixedStepLoop(int n, Record &&record) {
+  if (periodicFastForward) {
+    periodicLoop<Stepper>(n, record);
+    return;
+  }
+
+  using Coords = Coordinates<Stepper>;
+  const Coefficients k{A, B, C, D};
+  const double t0 = runOrigin;
+
+  // Lo stato avanza nelle coordinate del metodo, ricavate da x e y all'inizio
+  // dell'esecuzione; alla ripresa da un checkpoint sono quelle salvate
+  if (runDone == 0) {
+    coordP = x_0;
+    coordQ = y_0;
+    Coords::enter(coordP, coordQ);
+  }
+  double p = coordP, q = coordQ;
+
+  // runDone e' il numero di passi gia' conteggiati in rhsEvaluations
+  const int first = runDone + 1;
+  int i = first;
+  for (; i <= n; ++i) {
+    Coords::step(k, p, q, dt);
+    ++stepCount;
+    currentTime = t0 + dt * i;
+    bool recordNow = ++stepsSinceRecord == recordStride;
+    bool checkpoint =
+        checkpointInterval > 0 && stepCount % checkpointInterval == 0;
+    if (recordNow || monitorDrift || checkpoint)
+      Coords::leave(p, q, x_0, y_0);
+    if (recordNow) {
+      stepsSinceRecord = 0;
+      record(currentTime, x_0, y_0);
+    }
+    if (monitorDrift && driftExceeded()) {
+      ++i;
+      break;
+    }
+    if (checkpoint) {
+      coordP = p;
+      coordQ = q;
+      rhsEvaluations +=
+          static_cast<long long>(Stepper::rhsPerStep) * (i - runDone);
+      periodicCheckpoint(i);
+    }
+  }
+  if (i > first)
+    Coords::leave(p, q, x_0, y_0);
+  rhsEvaluations +=
+      static_cast<long long>(Stepper::rhsPerStep) * (i - 1 - runDone);
+  runDone = n;
+}
+
+// Come fixedStepLoop, ma controlla a ogni passo l'attraversamento della
+// sezione di Poincare' x = e2_x con x crescente. Dal primo attraversamento gli
+// stati vengono memorizzati; se al successivo y coincide entro la tolleranza
+// l'orbita e' chiusa, il periodo e' la differenza dei due istanti e i passi
+// rimanenti vengono interpolati dal ciclo memorizzato. Altrimenti il ciclo
+// riparte dall'ultimo attraversamento
+template <class Stepper, class Record>
+void Simulation::periodicLoop(int n, Record &&record) {
+  using Coords = Coordinates<Stepper>;
+  const Coefficients k{A, B, C, D};
+  const double t0 = runOrigin;
+  const double section = e2_x();
+  // L'attraversamento viene cercato nelle coordinate del metodo, cosi' x e y
+  // servono solo quando c'e'
+  const double sectionP = Coords::first(section);
+
+  if (runDone == 0) {
+    coordP = x_0;
+    coordQ = y_0;
+    Coords::enter(coordP, coordQ);
+  }
+  double p = coordP, q = coordQ;
+
+  const int first = runDone + 1;
+  int i = first;
+  for (; i <= n && period == 0.0; ++i) {
+    double p_prev = p, q_prev = q;
+    double t_prev = currentTime;
+
+    Coords::step(k, p, q, dt);
+    rhsEvaluations += Stepper::rhsPerStep;
+    ++stepCount;
+    currentTime = t0 + dt * i;
+    bool recordNow = ++stepsSinceRecord == recordStride;
+    bool crossing = p_prev < sectionP && p >= sectionP;
+    bool checkpoint =
+        checkpointInterval > 0 && stepCount % checkpointInterval == 0;
+    // Durante la memorizzazione del ciclo servono tutti gli stati
+    if (recordNow || monitorDrift || checkpoint || crossing || !cycleX.empty())
+      Coords::leave(p, q, x_0, y_0);
+    if (recordNow) {
+      stepsSinceRecord = 0;
+      record(currentTime, x_0, y_0);
+    }
+    if (monitorDrift && driftExceeded()) {
+      runDone = n;
+      return;
+    }
+
+    if (!cycleX.empty()) {
+      cycleX.push_back(x_0);
+      cycleY.push_back(y_0);
+    }
+
+    if (crossing) {
+      double x_prev, y_prev;
+      Coords::leave(p_prev, q_prev, x_prev, y_prev);
+
+      // Istante e y dell'attraversamento: zero dell'interpolante di Hermite
+      // di x(t), partendo dalla stima lineare (poche iterazioni di Newton)
+      double h = currentTime - t_prev;
+      double mx0 = A * x_prev - B * x_prev * y_prev;
+      double my0 = C * x_prev * y_prev - D * y_prev;
+      double mx1 = A * x_0 - B * x_0 * y_0;
+      double my1 = C * x_0 * y_0 - D * y_0;
+
+      double frac = (section - x_prev) / (x_0 - x_prev);
+      for (int iter = 0; iter < 3; ++iter) {
+        double slope = hermiteSlope(x_prev, mx0, x_0, mx1, h, frac);
+        if (slope == 0.0)
+          break;
+        frac -= (hermite(x_prev, mx0, x_0, mx1, h, frac) - section) / slope;
+      }
+      frac = std::clamp(frac, 0.0, 1.0);
+
+      double tc = t_prev + h * frac;
+      double yc = hermite(y_prev, my0, y_0, my1, h, frac);
+
+      if (!cycleX.empty() &&
+          std::fabs(yc - crossingY) <= closureTolerance * std::fabs(crossingY)) {
+        period = tc - crossingTime;
+      } else {
+        crossingTime = tc;
+        crossingY = yc;
+        cycleStart = t_prev;
+        cycleX = {x_prev, x_0};
+        cycleY = {y_prev, y_0};
+      }
+    }
+
+    if (checkpoint) {
+      coordP = p;
+      coordQ = q;
+      periodicCheckpoint(i);
+    }
+  }
+
+  if (i > n) {
+    if (i > first)
+      Coords::leave(p, q, x_0, y_0);
+    runDone = n;
+    return;
+  }
+
+  // Orbita chiusa: i passi rimanenti non vengono integrati, e si calcolano
+  // solo gli stati da salvare e quello finale
+  for (; i <= n; ++i) {
+    currentTime = t0 + dt * i;
+    ++stepCount;
+    if (++stepsSinceRecord == recordStride) {
+      stepsSinceRecord = 0;
+      double xi, yi;
+      cycleState(currentTime, xi, yi);
+      record(currentTime, xi, yi);
+    }
+    if (checkpointInterval > 0 && stepCount % checkpointInterval == 0)
+      periodicCheckpoint(i);
+  }
+  cycleState(currentTime, x_0, y_0);
+  runDone = n;
+}
+
+// Riporta time nel ciclo memorizzato e interpola con un polinomio cubico di
+// Hermite tra i due stati vicini, usando le derivate date dalle equazioni.
+// Costa circa quanto un passo di RK4 (fmod e due valutazioni del campo)
+void Simulation::cycleState(double time, double &x, double &y) const {
+  double phase = std::fmod(time - crossingTime, period);
+  if (phase < 0.0)
+    phase += period;
+
+  double pos = (crossingTime + phase - cycleStart) / dt;
+  std::size_t last = cycleX.size() - 2;
+  std::size_t m = std::min(static_cast<std::size_t>(std::max(pos, 0.0)), last);
+  double s = pos - static_cast<double>(m);
+
+  auto dxdt = [this](double xs, double ys) { return A * xs - B * xs * ys; };
+  auto dydt = [this](double xs, double ys) { return C * xs * ys - D * ys; };
+
+  double x0 = cycleX[m], y0 = cycleY[m];
+  double x1 = cycleX[m + 1], y1 = cycleY[m + 1];
+  x = hermite(x0, dxdt(x0, y0), x1, dxdt(x1, y1), dt, s);
+  y = hermite(y0, dydt(x0, y0), y1, dydt(x1, y1), dt, s);
+}
+
+// Ciclo adattivo di Dormand-Prince: passi non uniformi fino a coprire la
+// durata n * dt (fino a runEnd); ogni passo accettato viene passato a record
+template <class Record> void Simulation::adaptiveLoop(Record &&record) {
+  const double tEnd = runEnd;
+  while (currentTime < tEnd) {
+    double h = stepDP5(tEnd - currentTime);
+    currentTime = (tEnd - currentTime <= h) ? tEnd : currentTime + h;
+    ++stepCount;
+    if (++stepsSinceRecord == recordStride) {
+      stepsSinceRecord = 0;
+      record(currentTime, x_0, y_0);
+    }
+    if (monitorDrift && driftExceeded()) {
+      runEnd = currentTime;
+      break;
+    }
+    if (checkpointInterval > 0 && stepCount % checkpointInterval == 0)
+      periodicCheckpoint(0);
+  }
+}
+
+// Esegue n passi con il metodo a passo fisso Stepper salvando i campioni
+template <class Stepper> void Simulation::run(int n) {
+  beginRun(n);
+  continueRun<Stepper>();
+}
+
+// Completa l'esecuzione in corso con il metodo a passo fisso Stepper
+template <class Stepper> void Simulation::continueRun() {
+  // Lo spazio per i nuovi campioni viene riservato una volta sola
+  if (runLength > runDone) {
+    std::size_t samples =
+        (stepsSinceRecord + static_cast<std::size_t>(runLength - runDone)) /
+        recordStride;
+    data.x.reserve(data.x.size() + samples);
+    data.y.reserve(data.y.size() + samples);
+    t.reserve(t.size() + samples);
+  }
+
+  fixedStepLoop<Stepper>(runLength, [this](double ti, double xi, double yi) {
+    store(xi, yi);
+    t.push_back(ti);
+  });
+}
 
-  // Aggiornamento stato iniziale
-  x_0 = x_next;
-  y_0 = y_next;
+// Prepara una nuova esecuzione di n passi a partire dallo stato corrente
+void Simulation::beginRun(int n) {
+  runOrigin = currentTime;
+  runEnd = currentTime + dt * n;
+  runLength = n;
+  runDone = 0;
 }
 
+// Istanziazioni esplicite per i metodi a passo fisso disponibili
+template void Simulation::run<Euler>(int n);
+template void Simulation::run<RK4>(int n);
+template void Simulation::run<Symplectic>(int n);
+
 // Esegue la simulazione per n passi
 void Simulation::runSimulation(int n) {
-  for (int i = 1; i <= n; ++i) {
-    if (useRK4) {
-      evolveRK4();
+  if (monitorDrift && driftAction == DriftAction::Refine)
+    runRefining(n);
+  else
+    runStored(n);
+}
+
+void Simulation::runStored(int n) {
+  beginRun(n);
+  continueStored();
+}
+
+// Il metodo viene scelto una sola volta, prima del ciclo
+void Simulation::continueStored() {
+  switch (method) {
+  case Method::Euler:
+    continueRun<Euler>();
+    break;
+  case Method::RK4:
+    continueRun<RK4>();
+    break;
+  case Method::Symplectic:
+    continueRun<Symplectic>();
+    break;
+  case Method::DormandPrince:
+    adaptiveLoop([this](double ti, double xi, double yi) {
+      store(xi, yi);
+      t.push_back(ti);
+    });
+    break;
+  }
+}
+
+// Se la deriva supera la tolleranza, stato, dati salvati e statistiche tornano
+// a quelli di inizio esecuzione e la simulazione viene ripetuta con passo
+// dimezzato (e il doppio dei passi e del passo di registrazione, per coprire
+// la stessa durata con gli stessi istanti salvati); con il metodo adattivo si
+// riducono invece le tolleranze. Il costo dei tentativi scartati resta in
+// getRhsEvaluations. Se il numero di passi raddoppiato non sta in un int il
+// raffinamento si ferma e il rapporto resta quello dell'ultimo tentativo, con
+// violated vero. Al termine dt, tolleranze e passo di registrazione tornano ai
+// valori impostati, cosi' che le esecuzioni successive partano da quelli
+void Simulation::runRefining(int n) {
+  const double x_start = x_0, y_start = y_0, t_start = currentTime;
+  const std::size_t samples = data.x.size(), times = t.size();
+  const std::size_t strideStart = stepsSinceRecord;
+  const long long stepsStart = stepCount;
+  const double h_start = h_next;
+  const bool fsalStart = fsalValid;
+  const RunningStats sx = statsx, sy = statsy, sH = statsH;
+  const double maxDeviationStart = drift.maxDeviation;
+  const double dtStart = dt, absTolStart = absTol, relTolStart = relTol;
+  const std::size_t recordStrideStart = recordStride;
+  // Fattore tra i passi del tentativo corrente e quelli impostati
+  std::size_t scale = 1;
+
+  drift.violated = false;
+  for (int attempt = 0;; ++attempt) {
+    drift.dt = dt;
+    runStored(n);
+    if (!drift.violated || attempt == maxRefinements)
+      break;
+    if (method != Method::DormandPrince &&
+        (n > std::numeric_limits<int>::max() / 2 ||
+         recordStride > std::numeric_limits<std::size_t>::max() / 2))
+      break;
+
+    x_0 = x_start;
+    y_0 = y_start;
+    currentTime = t_start;
+    data.x.resize(samples);
+    data.y.resize(samples);
+    data.H.resize(std::min(data.H.size(), samples));
+    t.resize(times);
+    stepsSinceRecord = strideStart;
+    stepCount = stepsStart;
+    h_next = h_start;
+    fsalValid = fsalStart;
+    statsx = sx;
+    statsy = sy;
+    statsH = sH;
+    // Un checkpoint salvato durante il tentativo scartato si riferisce a
+    // valori che verranno sostituiti: il prossimo riscrive tutte le colonne
+    savedPath.clear();
+    drift.maxDeviation = maxDeviationStart;
+    drift.violated = false;
+    drift.violationStep = -1;
+    ++drift.refinements;
+
+    // Il ciclo memorizzato per l'avanzamento rapido vale solo per il vecchio
+    // passo
+    period = 0.0;
+    cycleX.clear();
+    cycleY.clear();
+
+    if (method == Method::DormandPrince) {
+      absTol /= 32.0;
+      relTol /= 32.0;
     } else {
-      evolve();
+      dt /= 2.0;
+      n *= 2;
+      stepsSinceRecord *= 2;
+      recordStride *= 2;
+      scale *= 2;
+    }
+  }
+
+  // I passi dall'ultimo stato salvato sono sempre un multiplo di scale,
+  // perche' partono da strideStart * scale e il resto e' preso modulo
+  // recordStride
+  dt = dtStart;
+  absTol = absTolStart;
+  relTol = relTolStart;
+  recordStride = recordStrideStart;
+  stepsSinceRecord /= scale;
+}
+
+// Esegue la simulazione in modalita' streaming: i campioni non vengono salvati
+// in Data ma raccolti in un blocco di chunkSize elementi, consegnato al sink e
+// poi riutilizzato, cosi' la memoria usata non dipende dalla durata
+void Simulation::runSimulation(int n, TrajectorySink &sink,
+                               std::size_t chunkSize) {
+  beginRun(n);
+  stream(sink, chunkSize, true);
+}
+
+// Completa in streaming l'esecuzione in corso; con fresh il primo campione
+// puo' essere lo stato iniziale
+void Simulation::stream(TrajectorySink &sink, std::size_t chunkSize,
+                        bool fresh) {
+  chunkSize = std::max<std::size_t>(chunkSize, 1);
+  TrajectoryChunk chunk;
+  chunk.reserve(chunkSize);
+
+  // I dati gia' salvati devono avere H, perche' la colonna H resti allineata
+  // a quelle di x e y
+  if (keepStreamed)
+    materializeH();
+
+  // H viene calcolato per l'intero blocco appena prima di consegnarlo
+  auto deliver = [&] {
+    if (computeHEnabled) {
+      chunk.H.resize(chunk.size());
+      computeH(Coefficients{A, B, C, D}, chunk.x.data(), chunk.y.data(),
+               chunk.H.data(), chunk.size());
+      for (double Hval : chunk.H)
+        statsH.push(Hval);
+    }
+    if (keepStreamed) {
+      t.append(chunk.t);
+      data.x.append(chunk.x);
+      data.y.append(chunk.y);
+      data.H.append(chunk.H);
     }
-    t.push_back(dt * i);
+    sink.consume(chunk);
+    chunk.clear();
+  };
+
+  auto record = [&](double ti, double xi, double yi) {
+    chunk.push(ti, xi, yi);
+    statsx.push(xi);
+    statsy.push(yi);
+    if (chunk.size() == chunkSize)
+      deliver();
+  };
+
+  // Se la simulazione non e' ancora partita e non e' stato salvato nulla, il
+  // primo campione e' lo stato iniziale
+  if (fresh && data.x.empty() && currentTime == 0.0)
+    record(currentTime, x_0, y_0);
+
+  // Prima di un checkpoint i campioni gia' calcolati vengono consegnati, cosi'
+  // che alla ripresa il sink riceva solo quelli successivi
+  flushPending = [&] {
+    if (!chunk.empty())
+      deliver();
+    sink.flush();
+  };
+  // Il gancio usa variabili locali: viene tolto all'uscita anche se il sink,
+  // il salvataggio o l'integrazione lanciano un'eccezione
+  struct HookReset {
+    std::function<void()> &hook;
+    ~HookReset() { hook = nullptr; }
+  } hookReset{flushPending};
+
+  switch (method) {
+  case Method::Euler:
+    fixedStepLoop<Euler>(runLength, record);
+    break;
+  case Method::RK4:
+    fixedStepLoop<RK4>(runLength, record);
+    break;
+  case Method::Symplectic:
+    fixedStepLoop<Symplectic>(runLength, record);
+    break;
+  case Method::DormandPrince:
+    adaptiveLoop(record);
+    break;
   }
+
+  flushPending = nullptr;
+  if (!chunk.empty())
+    deliver();
+  sink.flush();
 }
 
 // Scrive i dati temporali e delle popolazioni su file
-void Simulation::writeResults() const {
+void Simulation::writeResults(TextFormat format,
+                              const std::string &path) const {
   if (data.x.empty() || t.empty()) {
     std::cout << "Nessun dato disponibile.\n";
     return;
   }
 
-  std::ofstream out("ValueList.txt");
-  out << std::fixed << std::setprecision(6);
+  materializeH();
 
-  out << "TIME\t\tPREY(x)\t\tPREDATOR(y)\t\tH\n\n";
+  TextWriter out(path, format);
+  out.writeHeader(computeHEnabled);
 
   for (size_t m = 0; m < data.x.size(); ++m) {
-    out << t[m] << "\t" << data.x[m] << "\t" << data.y[m] << "\t" << data.H[m]
-        << "\n";
+    if (computeHEnabled)
+      out.writeRow(t[m], data.x[m], data.y[m], data.H[m]);
+    else
+      out.writeRow(t[m], data.x[m], data.y[m]);
   }
+}
 
-  out.close();
+// Scrive i dati nel formato binario a colonne
+void Simulation::writeResultsBinary(const std::string &path) const {
+  if (data.x.empty() || t.empty()) {
+    std::cout << "Nessun dato disponibile.\n";
+    return;
+  }
+
+  materializeH();
+  writeBinaryTrajectory(path, binaryHeader(), t, data.x, data.y, data.H);
 }
 
-// Calcola statistiche minime, massime e medie
-void Simulation::computeStatistics() const {
-  if (data.x.empty()) {
+// Comprime i dati e li scrive su file
+void Simulation::writeResultsCompressed(const std::string &path,
+                                        unsigned mantissaBits) const {
+  if (data.x.empty() || t.empty()) {
     std::cout << "Nessun dato disponibile.\n";
     return;
   }
 
-  auto [min_x, max_x] = std::minmax_element(data.x.begin(), data.x.end());
-  auto [min_y, max_y] = std::minmax_element(data.y.begin(), data.y.end());
-  auto [min_H, max_H] = std::minmax_element(data.H.begin(), data.H.end());
+  materializeH();
 
-  double mean_x = std::accumulate(data.x.begin(), data.x.end(), 0.0) / 
-                  static_cast<double>(data.x.size());
-  double mean_y = std::accumulate(data.y.begin(), data.y.end(), 0.0) / 
-                  static_cast<double>(data.y.size());
-  double mean_H = std::accumulate(data.H.begin(), data.H.end(), 0.0) / 
-                  static_cast<double>(data.H.size());
+  CompressedTrajectory trajectory(mantissaBits);
+  for (size_t m = 0; m < data.x.size(); ++m) {
+    if (computeHEnabled)
+      trajectory.push(t[m], data.x[m], data.y[m], data.H[m]);
+    else
+      trajectory.push(t[m], data.x[m], data.y[m]);
+  }
+  writeCompressedTrajectory(path, binaryHeader(), trajectory);
+}
 
-  std::ofstream out("Statistics.txt");
-  out << std::fixed << std::setprecision(6);
+void Simulation::writeResultsIndexed(const std::string &path,
+                                     std::size_t blockSize) const {
+  if (data.x.empty() || t.empty()) {
+    std::cout << "Nessun dato disponibile.\n";
+    return;
+  }
 
-  out << "STATISTICHE:\n\n";
-  out << "Prede (x):\n"
-      << "  Min: " << *min_x << "\n"
-      << "  Max: " << *max_x << "\n"
-      << "  Media: " << mean_x << "\n\n";
+  materializeH();
 
-  out << "Predatori (y):\n"
-      << "  Min: " << *min_y << "\n"
-      << "  Max: " << *max_y << "\n"
-      << "  Media: " << mean_y << "\n\n";
+  blockSize = std::max<std::size_t>(blockSize, 1);
+  IndexedTrajectoryWriter writer(path, binaryHeader(), blockSize);
+  TrajectoryChunk chunk;
+  chunk.reserve(blockSize);
+  for (size_t m = 0; m < data.x.size(); ++m) {
+    if (computeHEnabled)
+      chunk.push(t[m], data.x[m], data.y[m], data.H[m]);
+    else
+      chunk.push(t[m], data.x[m], data.y[m]);
+    if (chunk.size() == blockSize) {
+      writer.consume(chunk);
+      chunk.clear();
+    }
+  }
+  writer.consume(chunk);
+  writer.close();
+}
 
-  out << "Integrale del moto (H):\n"
-      << "  Min: " << *min_H << "\n"
-      << "  Max: " << *max_H << "\n"
-      << "  Media: " << mean_H << "\n";
+BinaryTrajectoryHeader Simulation::binaryHeader() const {
+  BinaryTrajectoryHeader header = makeBinaryHeader();
+  header.method = static_cast<std::uint32_t>(method);
+  header.A = A;
+  header.B = B;
+  header.C = C;
+  header.D = D;
+  header.x_0 = data.x.front();
+  header.y_0 = data.y.front();
+  header.dt = dt;
+  header.stride = binaryStride(recordStride);
+  return header;
+}
 
-  out.close();
+// Scrive le statistiche accumulate durante l'integrazione
+void Simulation::computeStatistics(const std::string &path) const {
+  if (statsx.count == 0) {
+    std::cout << "Nessun dato disponibile.\n";
+    return;
+  }
+
+  // Se il calcolo di H e' disattivato la sezione di H viene omessa
+  materializeH();
+  writeStatistics(path, statsx, statsy, statsH);
 }
 
 // Controlla la stabilità dell’integrale del moto
-bool Simulation::checkHStability(double tolerance) const {
+bool Simulation::checkHStability(double tolerance,
+                                 const std::string &path) const {
+  if (!computeHEnabled) {
+    std::cerr << "Calcolo di H disattivato, impossibile controllarne la "
+                 "stabilità.\n";
+    return false;
+  }
+
+  materializeH();
   if (data.H.empty()) {
     std::cerr << "Nessun dato disponibile per controllare la stabilità.\n";
     return false;
@@ -225,15 +1377,7 @@ bool Simulation::checkHStability(double tolerance) const {
     }
   }
 
-  std::ofstream out("H_Stability.txt");
-  out << std::fixed << std::setprecision(6);
-  out << "H iniziale: " << H0 << "\n";
-  out << "Massima deviazione relativa: " << maxDeviation << "\n";
-  out << "Tolleranza: " << tolerance << "\n";
-  out << "Stabile: " << (maxDeviation <= tolerance ? "SI" : "NO") << "\n";
-  out.close();
-
-  return maxDeviation <= tolerance;
+  return writeHStability(path, H0, maxDeviation, tolerance);
 }
 
 } // namespace pf
@@ -9,14 +9,51 @@
 #include <numeric>
 #include <algorithm>
 #include <iomanip>
+#include <string>
+#include <functional>
+#include <span>
+
+#include "integrators.hpp"
+#include "mapped_column.hpp"
+#include "running_stats.hpp"
+#include "trajectory_sink.hpp"
+#include "text_writer.hpp"
+#include "trajectory_io.hpp"
 
 namespace pf {
 
-// Struttura dati per contenere i vettori delle popolazioni e della funzione H
+// Struttura dati per contenere i vettori delle popolazioni e della funzione H,
+// nella memoria del processo o in file mappati (vedi mapped_column.hpp)
 struct Data {
-  std::vector<double> x; // popolazione delle prede
-  std::vector<double> y; // popolazione dei predatori
-  std::vector<double> H; // integrale del moto (funzione conservata)
+  MappedColumn x; // popolazione delle prede
+  MappedColumn y; // popolazione dei predatori
+  MappedColumn H; // integrale del moto (funzione conservata)
+};
+
+// Metodi di integrazione disponibili
+enum class Method {
+  Euler,        // Euler esplicito (formula semplificata)
+  RK4,          // Runge-Kutta di ordine 4, passo fisso
+  DormandPrince, // Runge-Kutta adattivo Dormand-Prince 5(4)
+  Symplectic     // splitting simplettico di ordine 4 in coordinate logaritmiche
+};
+
+// Cosa fare quando il monitor della deriva di H supera la tolleranza
+enum class DriftAction {
+  Report, // registra la violazione e prosegue
+  Stop,   // interrompe la simulazione
+  Refine  // ripete la simulazione con passo dimezzato
+};
+
+// Risultato del monitor della deriva di H
+struct DriftReport {
+  double H0 = 0.0;              // H all'attivazione del monitor
+  double maxDeviation = 0.0;    // massima deviazione relativa da H0
+  bool violated = false;        // tolleranza superata
+  long long violationStep = -1; // passo in cui e' stata superata
+  double violationTime = 0.0;   // istante in cui e' stata superata
+  int refinements = 0;          // dimezzamenti del passo effettuati
+  double dt = 0.0;              // passo usato dall'ultima esecuzione
 };
 
 // Classe che simula il sistema di equazioni Lotka-Volterra
@@ -31,14 +68,159 @@ private:
   // Passo temporale per l'evoluzione
   double dt;
 
-  // Flag per decidere se usare il metodo Runge-Kutta 4 (RK4)
-  bool useRK4 = false;
+  // Metodo di integrazione usato da runSimulation
+  Method method = Method::Euler;
+
+  // Tolleranze assoluta e relativa del metodo adattivo
+  double absTol = 1e-8;
+  double relTol = 1e-8;
+
+  // Passo proposto per il prossimo passo adattivo (0 = parte da dt)
+  double h_next = 0.0;
+
+  // Derivate nell'ultimo stato calcolato da evolveDP5 (proprieta' FSAL)
+  double fsal_x = 0.0, fsal_y = 0.0, fsal_dxdt = 0.0, fsal_dydt = 0.0;
+  bool fsalValid = false;
+
+  // Tempo corrispondente allo stato corrente
+  double currentTime = 0.0;
+
+  // Numero di valutazioni del campo vettoriale (lato destro delle equazioni)
+  long long rhsEvaluations = 0;
+
+  // Passo di registrazione: runSimulation salva uno stato ogni recordStride
+  // passi di integrazione
+  std::size_t recordStride = 1;
+
+  // Passi effettuati dall'ultimo stato salvato
+  std::size_t stepsSinceRecord = 0;
+
+  // Avanzamento rapido periodico: una volta chiusa l'orbita, i passi
+  // successivi vengono ricavati dal ciclo memorizzato invece che integrati
+  bool periodicFastForward = false;
+  double closureTolerance = 1e-6;
+
+  // Periodo dell'orbita (0 finche' non e' stato rilevato)
+  double period = 0.0;
+
+  // Istante e valore di y dell'attraversamento della sezione di Poincare'
+  // x = e2_x (con x crescente) da cui parte il ciclo memorizzato
+  double crossingTime = 0.0, crossingY = 0.0;
+
+  // Stati del ciclo a passo dt, a partire dall'istante cycleStart
+  std::vector<double> cycleX, cycleY;
+  double cycleStart = 0.0;
+
+  // Passi di integrazione effettuati (accettati, per il metodo adattivo)
+  long long stepCount = 0;
+
+  // Monitor della deriva di H: controllata dopo ogni passo di integrazione
+  bool monitorDrift = false;
+  double driftTolerance = 1e-4;
+  DriftAction driftAction = DriftAction::Stop;
+  int maxRefinements = 4;
+  DriftReport drift;
+
+  // Esecuzione in corso (runSimulation o run): istante iniziale, numero di
+  // passi richiesti e gia' effettuati, istante finale per il metodo adattivo.
+  // Sono salvati nei checkpoint, cosi' che la ripresa calcoli gli stessi
+  // istanti dell'esecuzione senza interruzioni
+  double runOrigin = 0.0, runEnd = 0.0;
+  int runLength = 0, runDone = 0;
+
+  // Stato nelle coordinate del metodo a passo fisso (ln x e ln y per
+  // Symplectic) all'ultimo checkpoint: la ripresa prosegue da questi valori e
+  // non da quelli riconvertiti da x e y
+  double coordP = 0.0, coordQ = 0.0;
+
+  // Checkpoint periodico ogni checkpointInterval passi (0 = disattivato)
+  long long checkpointInterval = 0;
+  std::string checkpointPath = "Checkpoint.bin";
+
+  // Valori delle colonne gia' scritti accanto al checkpoint savedPath, con
+  // identificativo savedId: i salvataggi successivi sullo stesso percorso
+  // aggiungono solo quelli nuovi (percorso vuoto: le colonne vanno riscritte
+  // da capo)
+  mutable std::string savedPath;
+  mutable std::uint64_t savedId = 0;
+  mutable std::size_t savedTimes = 0, savedSamples = 0, savedH = 0;
+
+  // In streaming consegna al sink i campioni in attesa prima di un checkpoint
+  std::function<void()> flushPending;
+
+  // In streaming salva anche i campioni consegnati al sink
+  bool keepStreamed = false;
+
+  // Calcola e salva un passo con il metodo a passo fisso Stepper
+  template <class Stepper> void advance();
+
+  // Passo adattivo di Dormand-Prince senza salvataggio dei dati
+  double stepDP5(double maxStep);
+
+  // Calcola H per gli stati salvati che non lo hanno ancora, in un unico
+  // passaggio su x e y
+  void materializeH() const;
+
+  // Aggiorna il monitor con lo stato corrente; restituisce true se la
+  // simulazione deve fermarsi
+  bool driftExceeded();
+
+  // Esegue n passi salvando gli stati, con il metodo scelto
+  void runStored(int n);
+
+  // runStored ripetuta con passo dimezzato finche' la deriva di H resta entro
+  // la tolleranza (al massimo maxRefinements volte)
+  void runRefining(int n);
+
+  // Intestazione dei file binari con i parametri della simulazione
+  BinaryTrajectoryHeader binaryHeader() const;
+
+  // Prepara una nuova esecuzione di n passi a partire dallo stato corrente
+  void beginRun(int n);
+
+  // Completano l'esecuzione in corso salvando gli stati, con il metodo
+  // Stepper o con quello scelto
+  template <class Stepper> void continueRun();
+  void continueStored();
+
+  // Completa l'esecuzione in corso in modalita' streaming
+  void stream(TrajectorySink &sink, std::size_t chunkSize, bool fresh);
 
-  // Oggetto dati che contiene i vettori delle popolazioni e dell'integrale H
-  Data data;
+  // Salva il checkpoint periodico dopo il passo i dell'esecuzione in corso
+  void periodicCheckpoint(int i);
+
+  // Cicli di integrazione dal passo runDone + 1: ogni nuovo campione viene
+  // passato a record
+  template <class Stepper, class Record>
+  void fixedStepLoop(int n, Record &&record);
+  template <class Record> void adaptiveLoop(Record &&record);
+
+  // Ciclo a passo fisso con rilevamento della chiusura dell'orbita e
+  // avanzamento rapido sul ciclo memorizzato
+  template <class Stepper, class Record>
+  void periodicLoop(int n, Record &&record);
+
+  // Stato sull'orbita chiusa all'istante time, interpolato dal ciclo
+  void cycleState(double time, double &x, double &y) const;
+
+  // Oggetto dati che contiene i vettori delle popolazioni e dell'integrale H.
+  // H viene calcolato solo quando serve, anche da metodi const: per questo
+  // l'oggetto e' mutable
+  mutable Data data;
+
+  // Flag per decidere se calcolare l'integrale del moto H
+  bool computeHEnabled = true;
 
   // Vettore dei tempi corrispondenti ai dati salvati
-  std::vector<double> t;
+  MappedColumn t;
+
+  // Statistiche di x, y e H aggiornate a ogni nuovo stato, salvato o
+  // consegnato in streaming (quelle di H quando H viene calcolato)
+  RunningStats statsx, statsy;
+  mutable RunningStats statsH;
+
+  // Salva un nuovo stato in Data aggiornando le statistiche
+  void store(double xi, double yi);
 
 public:
   // Costruttore con parametri iniziali per i coefficienti e condizioni iniziali
@@ -48,17 +230,114 @@ public:
   // Imposta se utilizzare il metodo RK4 per l'evoluzione
   void setUseRK4(bool flag);
 
+  // Imposta il metodo di integrazione
+  void setMethod(Method newMethod);
+
+  // Restituisce il metodo di integrazione in uso
+  Method getMethod() const;
+
+  // Imposta le tolleranze assoluta e relativa del metodo adattivo
+  void setTolerances(double newAbsTol, double newRelTol);
+
+  // Numero di valutazioni del lato destro effettuate finora
+  long long getRhsEvaluations() const;
+
+  // Imposta ogni quanti passi di integrazione runSimulation salva uno stato
+  // in Data e t (1 = tutti i passi)
+  void setRecordStride(std::size_t stride);
+
+  // Imposta l'intervallo di tempo tra due stati salvati, arrotondato a un
+  // multiplo di dt (con il metodo adattivo conta i passi accettati)
+  void setOutputInterval(double interval);
+
+  // Restituisce il passo di registrazione
+  std::size_t getRecordStride() const;
+
+  // Attiva l'avanzamento rapido periodico per i metodi a passo fisso: quando
+  // l'orbita torna sulla sezione x = e2_x() con y uguale entro la tolleranza
+  // relativa indicata, il periodo viene registrato e i passi rimanenti
+  // vengono interpolati dal ciclo gia' calcolato. Si risparmiano solo i passi
+  // non salvati: ogni stato salvato richiede un'interpolazione di costo
+  // simile a un passo di RK4, quindi il guadagno si vede con un passo di
+  // registrazione (setRecordStride) grande, mentre con 1 e' quasi nullo
+  void setPeriodicFastForward(bool flag, double tolerance = 1e-6);
+
+  // Periodo dell'orbita rilevato (0 se non ancora rilevato)
+  double getPeriod() const;
+
+  // Attiva il monitor della deriva di H durante l'integrazione: dopo ogni
+  // passo la deviazione relativa di H dal valore attuale viene confrontata con
+  // la tolleranza, e al primo superamento si esegue action. Refine vale solo
+  // per runSimulation(n): in streaming i campioni sono gia' stati consegnati,
+  // quindi la simulazione viene interrotta come con Stop. Dopo il
+  // raffinamento dt, tolleranze e passo di registrazione restano quelli
+  // impostati; il passo effettivamente usato e' in getDriftReport().dt
+  void setDriftMonitor(bool flag, double tolerance = 1e-4,
+                       DriftAction action = DriftAction::Stop,
+                       int refinements = 4);
+
+  // Risultato del monitor della deriva di H
+  const DriftReport &getDriftReport() const;
+
+  // Passi di integrazione effettuati finora
+  long long getStepCount() const;
+
+  // Salva su file binario l'intero stato della simulazione: parametri,
+  // metodo e impostazioni, stato corrente, avanzamento dell'esecuzione in
+  // corso, dati salvati e statistiche. Il file viene scritto con un nome
+  // temporaneo e poi rinominato, quindi un'interruzione durante la scrittura
+  // non rovina il checkpoint precedente. t, x, y e H stanno nei file
+  // path.t.col, path.x.col, path.y.col e path.H.col, a cui i salvataggi
+  // successivi dello stesso oggetto aggiungono solo i valori nuovi
+  void saveCheckpoint(const std::string &path = "Checkpoint.bin") const;
+
+  // Ripristina lo stato salvato da saveCheckpoint; lancia std::runtime_error
+  // se il file non e' valido
+  void loadCheckpoint(const std::string &path = "Checkpoint.bin");
+
+  // Salva un checkpoint ogni interval passi di integrazione durante
+  // runSimulation e run (0 = disattivato)
+  void setCheckpointInterval(long long interval,
+                             const std::string &path = "Checkpoint.bin");
+
+  // Completa l'esecuzione interrotta dopo loadCheckpoint: i dati ottenuti
+  // sono identici bit a bit a quelli dell'esecuzione senza interruzioni.
+  // Con DriftAction::Refine la ripresa completa il tentativo in corso senza
+  // ulteriori dimezzamenti del passo
+  void resumeSimulation();
+
+  // Come resumeSimulation, in streaming: il sink riceve i campioni successivi
+  // al checkpoint (quelli precedenti sono stati consegnati prima di salvarlo)
+  void resumeSimulation(TrajectorySink &sink, std::size_t chunkSize = 4096);
+
+  // Salva t, x, y e H nei file mappati prefix + "t.col", "x.col", "y.col" e
+  // "H.col" invece che nella memoria del processo, per simulazioni piu' grandi
+  // della RAM; i dati gia' salvati vengono copiati nei file. Ogni file contiene
+  // i double della colonna e puo' essere riaperto con MappedColumn(path,
+  // false). Con prefix vuoto i dati tornano nella memoria del processo e i
+  // file vengono chiusi alla lunghezza esatta dei dati
+  void setMappedStorage(const std::string &prefix);
+
   // Getter per il vettore dei tempi
-  const std::vector<double> &gett() const;
+  std::span<const double> gett() const;
 
   // Getter per il vettore della popolazione delle prede
-  const std::vector<double> &getx() const;
+  std::span<const double> getx() const;
 
   // Getter per il vettore della popolazione dei predatori
-  const std::vector<double> &gety() const;
+  std::span<const double> gety() const;
   
-  // Getter per il vettore dell'integrale primo
-  const std::vector<double> &getH() const;
+  // Getter per il vettore dell'integrale primo, calcolato alla prima
+  // richiesta (vuoto se il calcolo di H e' disattivato)
+  std::span<const double> getH() const;
+
+  // Attiva o disattiva il calcolo dell'integrale del moto H
+  void setComputeH(bool flag);
+
+  // Statistiche di tutti gli stati prodotti finora, anche in streaming
+  const RunningStats &getxStatistics() const;
+  const RunningStats &getyStatistics() const;
+  const RunningStats &getHStatistics() const;
 
   // Calcola la coordinata x del punto di equilibrio non banale e_2
   double e2_x() const;
@@ -67,7 +346,7 @@ public:
   double e2_y() const;
 
   // Scrive su file le coordinate del punto di equilibrio e_2
-  void writeCoordinates() const;
+  void writeCoordinates(const std::string &path = "e_2Coordinates.txt") const;
 
   // Inizializza i vettori delle popolazioni, di H e del tempo con i valori iniziali
   void initializeVectors();
@@ -78,17 +357,62 @@ public:
   // Calcola un passo di evoluzione usando il metodo Runge-Kutta di ordine 4 (RK4)
   void evolveRK4();
 
-  // Esegue la simulazione per n passi temporali, scegliendo il metodo di evoluzione
+  // Calcola un passo di evoluzione con lo splitting simplettico in
+  // coordinate logaritmiche (u = ln x, v = ln y), che mantiene H limitato
+  void evolveSymplectic();
+
+  // Calcola un passo adattivo accettato con Dormand-Prince 5(4), lungo al
+  // massimo maxStep, e restituisce l'ampiezza del passo effettuato
+  double evolveDP5(double maxStep);
+
+  // Esegue n passi con il metodo a passo fisso Stepper (pf::Euler, pf::RK4,
+  // pf::Symplectic), scelto a tempo di compilazione
+  template <class Stepper> void run(int n);
+
+  // Esegue la simulazione per n passi temporali, scegliendo il metodo di
+  // evoluzione; con il metodo adattivo copre la stessa durata n * dt
   void runSimulation(int n);
 
-  // Scrive su file i risultati temporali delle popolazioni e di H
-  void writeResults() const;
+  // Come runSimulation(n), ma in modalita' streaming: i campioni vengono
+  // consegnati al sink in blocchi di chunkSize elementi invece di essere
+  // salvati, e la memoria usata resta costante. Se la simulazione non e'
+  // ancora partita e non e' stato salvato nulla, il primo campione e' lo
+  // stato iniziale
+  void runSimulation(int n, TrajectorySink &sink, std::size_t chunkSize = 4096);
+
+  // Con flag = true, runSimulation in modalita' streaming salva anche i
+  // campioni consegnati al sink, come runSimulation(n): ad esempio per
+  // disegnare la simulazione mentre procede e conservarne i dati. I campioni
+  // vengono salvati blocco per blocco, subito prima di essere consegnati
+  void setKeepStreamedData(bool flag);
+
+  // Scrive su file i risultati temporali delle popolazioni e di H; con
+  // TextFormat::Shortest i numeri rileggono esattamente i valori calcolati
+  void writeResults(TextFormat format = TextFormat::Fixed,
+                    const std::string &path = "ValueList.txt") const;
+
+  // Scrive i risultati nel formato binario a colonne (vedi trajectory_io.hpp),
+  // piu' compatto e veloce del testo e senza perdita di precisione
+  void writeResultsBinary(const std::string &path = "ValueList.bin") const;
+
+  // Scrive i risultati compressi (vedi compressed_trajectory.hpp); con
+  // mantissaBits < 52 x, y e H vengono arrotondati per comprimere di piu'
+  void writeResultsCompressed(const std::string &path = "ValueList.lvz",
+                              unsigned mantissaBits = 52) const;
+
+  // Scrive i risultati nel formato indicizzato (vedi indexed_trajectory.hpp),
+  // in blocchi di blockSize campioni: intervalli di tempo e stati in un
+  // istante si leggono senza scorrere l'intero file
+  void writeResultsIndexed(const std::string &path = "ValueList.lvi",
+                           std::size_t blockSize = 4096) const;
 
-  // Calcola e scrive statistiche minime, massime e medie di x, y e H
-  void computeStatistics() const;
+  // Scrive su file le statistiche (minimo, massimo, media, varianza) di x, y e
+  // H, accumulate durante l'integrazione: non serve aver salvato i dati
+  void computeStatistics(const std::string &path = "Statistics.txt") const;
 
   // Controlla se l'integrale del moto H è stabile entro una certa tolleranza
-  bool checkHStability(double tolerance) const;
+  bool checkHStability(double tolerance,
+                       const std::string &path = "H_Stability.txt") const;
 };
 
 } // namespace pf
@@ -0,0 +1,182 @@
+// Benchmark del costo per passo: confronta il ciclo con scelta del metodo a
+// ogni passo (chiamate fuori linea a evolve/evolveRK4/evolveSymplectic) con il
+// nucleo specializzato a tempo di compilazione Simulation::run<Stepper>, e la
+// scrittura in streaming su file sincrona con quella tramite AsyncSink,
+// l'esportazione in testo con iostream con quella tramite TextWriter e
+// l'esplorazione dei parametri su un thread con quella su tutti i core
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "lotka_volterra.hpp"
+#include "sweep.hpp"
+#include "text_writer.hpp"
+#include "trajectory_sink.hpp"
+
+namespace {
+
+constexpr int steps = 2000000;
+constexpr int repetitions = 5;
+
+// Restituisce il miglior tempo per passo (in ns) su alcune ripetizioni
+template <class Body> double nsPerStep(Body body) {
+  double best = 0.0;
+  for (int r = 0; r < repetitions; ++r) {
+    pf::Simulation sim(1.0, 0.5, 0.2, 0.7, 5, 3, 0.001);
+    sim.initializeVectors();
+
+    auto start = std::chrono::steady_clock::now();
+    body(sim);
+    auto end = std::chrono::steady_clock::now();
+
+    double ns = std::chrono::duration<double, std::nano>(end - start).count() /
+                steps;
+    if (r == 0 || ns < best)
+      best = ns;
+  }
+  return best;
+}
+
+// Ciclo come quello originale di runSimulation: il metodo viene controllato a
+// ogni passo e il passo e' una chiamata non espandibile
+double runtimeLoop(pf::Method method) {
+  return nsPerStep([method](pf::Simulation &sim) {
+    for (int i = 1; i <= steps; ++i) {
+      if (method == pf::Method::RK4) {
+        sim.evolveRK4();
+      } else if (method == pf::Method::Symplectic) {
+        sim.evolveSymplectic();
+      } else {
+        sim.evolve();
+      }
+    }
+  });
+}
+
+// Nucleo specializzato per il metodo Stepper
+template <class Stepper> double templatedLoop() {
+  return nsPerStep([](pf::Simulation &sim) { sim.run<Stepper>(steps); });
+}
+
+void report(const std::string &name, double before, double after) {
+  std::cout << std::left << std::setw(12) << name << std::right << std::fixed
+            << std::setprecision(2) << std::setw(12) << before
+            << std::setw(12) << after << std::setw(10) << before / after
+            << "x\n";
+}
+
+// Tempo totale (ms) di una simulazione RK4 scritta in streaming su file,
+// direttamente o tramite il thread di AsyncSink
+double streamingMs(bool async) {
+  const char *path = "Bench_ValueList.txt";
+  pf::Simulation sim(1.0, 0.5, 0.2, 0.7, 5, 3, 0.001);
+  sim.setMethod(pf::Method::RK4);
+
+  auto start = std::chrono::steady_clock::now();
+  {
+    pf::FileSink file(path);
+    if (async) {
+      pf::AsyncSink writer(file);
+      sim.runSimulation(steps, writer);
+    } else {
+      sim.runSimulation(steps, file);
+    }
+  }
+  auto end = std::chrono::steady_clock::now();
+
+  std::remove(path);
+  return std::chrono::duration<double, std::milli>(end - start).count();
+}
+
+// Tempo (ms) per scrivere textRows righe t, x, y, H come faceva writeResults
+// con iostream, oppure con TextWriter
+constexpr int textRows = 10000000;
+
+double textExportMs(bool fast) {
+  const char *path = "Bench_ValueList.txt";
+  pf::Simulation sim(1.0, 0.5, 0.2, 0.7, 5, 3, 0.001);
+  sim.setMethod(pf::Method::RK4);
+  sim.initializeVectors();
+  sim.runSimulation(textRows / 10 - 1);
+  std::span<const double> x = sim.getx();
+  std::span<const double> y = sim.gety();
+  std::span<const double> H = sim.getH();
+  const std::size_t size = x.size();
+
+  auto start = std::chrono::steady_clock::now();
+  if (fast) {
+    pf::TextWriter out(path);
+    out.write("TIME\t\tPREY(x)\t\tPREDATOR(y)\t\tH\n\n");
+    for (std::size_t m = 0; m < static_cast<std::size_t>(textRows); ++m)
+      out.writeRow(0.001 * static_cast<double>(m), x[m % size], y[m % size],
+                   H[m % size]);
+  } else {
+    std::ofstream out(path);
+    out << std::fixed << std::setprecision(6);
+    out << "TIME\t\tPREY(x)\t\tPREDATOR(y)\t\tH\n\n";
+    for (std::size_t m = 0; m < static_cast<std::size_t>(textRows); ++m)
+      out << 0.001 * static_cast<double>(m) << "\t" << x[m % size] << "\t"
+          << y[m % size] << "\t" << H[m % size] << "\n";
+  }
+  auto end = std::chrono::steady_clock::now();
+
+  std::remove(path);
+  return std::chrono::duration<double, std::milli>(end - start).count();
+}
+
+// Tempo (ms) di un'esplorazione di 64 simulazioni RK4 su threads thread
+double sweepMs(unsigned threads) {
+  pf::SweepSpec spec;
+  spec.A = pf::linspace(0.8, 1.2, 4);
+  spec.B = pf::linspace(0.4, 0.6, 4);
+  spec.C = {0.2};
+  spec.D = pf::linspace(0.6, 0.8, 4);
+  spec.x_0 = {5};
+  spec.y_0 = {3};
+  spec.steps = 200000;
+
+  auto start = std::chrono::steady_clock::now();
+  pf::runSweep(spec, threads);
+  auto end = std::chrono::steady_clock::now();
+  return std::chrono::duration<double, std::milli>(end - start).count();
+}
+
+} // namespace
+
+int main() {
+  std::cout << "Costo per passo (ns), " << steps << " passi\n\n";
+  std::cout << std::left << std::setw(12) << "metodo" << std::right
+            << std::setw(12) << "runtime" << std::setw(12) << "template"
+            << std::setw(11) << "speedup\n";
+
+  report("Euler", runtimeLoop(pf::Method::Euler), templatedLoop<pf::Euler>());
+  report("RK4", runtimeLoop(pf::Method::RK4), templatedLoop<pf::RK4>());
+  report("Symplectic", runtimeLoop(pf::Method::Symplectic),
+         templatedLoop<pf::Symplectic>());
+
+  double sync = streamingMs(false);
+  double async = streamingMs(true);
+  std::cout << "\nScrittura in streaming (ms): sincrona " << sync
+            << ", asincrona " << async << "\n";
+
+  double slowText = textExportMs(false);
+  double fastText = textExportMs(true);
+  std::cout << "Esportazione in testo di " << textRows
+            << " righe (ms): iostream " << slowText << ", TextWriter "
+            << fastText << " (" << slowText / fastText << "x)\n";
+
+  unsigned cores = std::max(1u, std::thread::hardware_concurrency());
+  double serial = sweepMs(1);
+  double parallel = sweepMs(cores);
+  std::cout << "Esplorazione di 64 simulazioni (ms): 1 thread " << serial
+            << ", " << cores << " thread " << parallel << " ("
+            << serial / parallel << "x)\n";
+
+  return 0;
+}
@@ -1,7 +1,23 @@
 #define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
 #include "doctest.h"
 #include "lotka_volterra.hpp"
+#include "ensemble.hpp"
+#include "trajectory_sink.hpp"
+#include "sweep.hpp"
+#include "trajectory_io.hpp"
+#include "compressed_trajectory.hpp"
+#include "indexed_trajectory.hpp"
+#include "cli.hpp"
+#include "decimation.hpp"
+#include <algorithm>
 #include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <iomanip>
+#include <limits>
+#include <sstream>
+#include <thread>
 
 TEST_CASE("Testing the simulation given the first set of parameters and "
           "initial values") {
@@ -239,3 +255,1724 @@ TEST_CASE("Testing evolveRK4 predator extinction") {
   CHECK(sim8.gety().back() == 0);
   CHECK(sim8.getx().back() > 0);
 }
+
+TEST_CASE("Testing the ensemble against single simulations") {
+  pf::Ensemble ens(0.001);
+  ens.addSystem(1.1, 0.4, 0.1, 0.4, 80, 20);
+  ens.addSystem(1.2, 0.5, 0.2, 0.7, 25, 15);
+  ens.addSystem(0.6, 2.5, 0.3, 0.5, 8, 12);
+
+  pf::Simulation sim1(1.1, 0.4, 0.1, 0.4, 80, 20, 0.001);
+  pf::Simulation sim2(1.2, 0.5, 0.2, 0.7, 25, 15, 0.001);
+  pf::Simulation sim3(0.6, 2.5, 0.3, 0.5, 8, 12, 0.001);
+
+  SUBCASE("initial values of H") {
+    sim1.initializeVectors();
+    CHECK(ens.size() == 3);
+    CHECK(ens.getH()[0] == doctest::Approx(sim1.getH()[0]));
+  }
+
+  SUBCASE("Euler") {
+    for (auto *sim : {&sim1, &sim2, &sim3}) {
+      sim->initializeVectors();
+      sim->runSimulation(80000);
+    }
+    ens.runSimulation(80000);
+    CHECK(ens.getx()[0] == doctest::Approx(sim1.getx().back()));
+    CHECK(ens.gety()[1] == doctest::Approx(sim2.gety().back()));
+    CHECK(ens.getH()[1] == doctest::Approx(sim2.getH().back()));
+    CHECK(ens.getx()[2] == 0);
+    CHECK(ens.gety()[2] == 0);
+    CHECK(ens.getH()[2] == std::numeric_limits<double>::infinity());
+  }
+
+  SUBCASE("RK4") {
+    ens.setUseRK4(true);
+    for (auto *sim : {&sim1, &sim2, &sim3}) {
+      sim->setUseRK4(true);
+      sim->initializeVectors();
+      sim->runSimulation(5000);
+    }
+    ens.runSimulation(4999);
+    ens.evolveRK4();
+    CHECK(ens.getx()[0] == doctest::Approx(sim1.getx().back()));
+    CHECK(ens.gety()[0] == doctest::Approx(sim1.gety().back()));
+    CHECK(ens.getx()[1] == doctest::Approx(sim2.getx().back()));
+    CHECK(ens.getH()[1] == doctest::Approx(sim2.getH().back()));
+    CHECK(ens.gety()[2] == doctest::Approx(sim3.gety().back()));
+  }
+}
+
+TEST_CASE("Testing the adaptive Dormand-Prince method") {
+  pf::Simulation sim9(1.0, 0.5, 0.2, 0.7, 5, 3, 0.001);
+  sim9.setMethod(pf::Method::DormandPrince);
+  sim9.setTolerances(1e-10, 1e-10);
+  sim9.initializeVectors();
+  sim9.runSimulation(100000);
+
+  SUBCASE("the run covers the same duration with non-uniform time points") {
+    CHECK(sim9.gett().back() == doctest::Approx(100.0));
+    CHECK(sim9.gett().size() == sim9.getx().size());
+    CHECK(sim9.getH().size() == sim9.getx().size());
+    CHECK(sim9.gett().size() < 100001);
+    CHECK(sim9.gett()[2] - sim9.gett()[1] != doctest::Approx(0.001));
+    CHECK(std::is_sorted(sim9.gett().begin(), sim9.gett().end()));
+  }
+
+  SUBCASE("H stays stable with far fewer evaluations than RK4") {
+    double H0 = sim9.getH().front();
+    double maxDeviation = 0.0;
+    for (double Hval : sim9.getH())
+      maxDeviation = std::max(maxDeviation, std::fabs(Hval - H0) / std::fabs(H0));
+    CHECK(maxDeviation < 1e-7);
+    // RK4 a dt = 0.001 richiede 4 valutazioni per 100000 passi
+    CHECK(sim9.getRhsEvaluations() < 400000 / 10);
+  }
+}
+
+TEST_CASE("Testing Dormand-Prince extinction scenario") {
+  pf::Simulation sim10(0.6, 2.5, 0.3, 0.5, 8, 12, 0.001);
+  sim10.setMethod(pf::Method::DormandPrince);
+  sim10.initializeVectors();
+  sim10.runSimulation(80000);
+
+  CHECK(sim10.getx().back() == 0);
+  CHECK(sim10.gety().back() == 0);
+  CHECK(sim10.gett().back() == doctest::Approx(80.0));
+}
+
+TEST_CASE("Testing the symplectic method with a large time step") {
+  pf::Simulation sim11(1.0, 0.5, 0.2, 0.7, 5, 3, 0.1);
+  sim11.setMethod(pf::Method::Symplectic);
+  sim11.initializeVectors();
+
+  pf::Simulation sim12(1.0, 0.5, 0.2, 0.7, 5, 3, 0.1);
+  sim12.setUseRK4(true);
+  sim12.initializeVectors();
+
+  auto maxDeviation = [](std::span<const double> H) {
+    double result = 0.0;
+    for (double Hval : H)
+      result = std::max(result, std::fabs(Hval - H.front()) / std::fabs(H.front()));
+    return result;
+  };
+
+  SUBCASE("one step stays close to RK4") {
+    sim11.runSimulation(1);
+    sim12.runSimulation(1);
+    CHECK(sim11.getx()[1] == doctest::Approx(sim12.getx()[1]).epsilon(1e-5));
+    CHECK(sim11.gety()[1] == doctest::Approx(sim12.gety()[1]).epsilon(1e-5));
+  }
+
+  SUBCASE("H stays bounded over a long horizon") {
+    sim11.runSimulation(100000);
+    sim12.runSimulation(100000);
+    CHECK(sim11.gett().back() == doctest::Approx(10000.0));
+    CHECK(maxDeviation(sim11.getH()) < 1e-4);
+    CHECK(maxDeviation(sim11.getH()) < maxDeviation(sim12.getH()));
+  }
+}
+
+TEST_CASE("Testing the compile-time selected stepping core") {
+  pf::Simulation sim13(1.1, 0.4, 0.1, 0.4, 80, 20, 0.001);
+  pf::Simulation sim14(1.1, 0.4, 0.1, 0.4, 80, 20, 0.001);
+  sim13.initializeVectors();
+  sim14.initializeVectors();
+
+  SUBCASE("run<RK4> matches evolveRK4 step by step") {
+    sim13.run<pf::RK4>(500);
+    for (int i = 0; i < 500; ++i)
+      sim14.evolveRK4();
+    CHECK(sim13.getx()[500] == sim14.getx()[500]);
+    CHECK(sim13.gety()[500] == sim14.gety()[500]);
+    CHECK(sim13.getH()[500] == sim14.getH()[500]);
+    CHECK(sim13.gett().size() == 501);
+    CHECK(sim13.gett()[500] == doctest::Approx(0.5));
+  }
+
+  SUBCASE("run<Euler> matches runSimulation with Euler") {
+    sim13.run<pf::Euler>(370);
+    sim14.runSimulation(370);
+    CHECK(sim13.getx()[370] == sim14.getx()[370]);
+    CHECK(sim13.gety()[370] == sim14.gety()[370]);
+    CHECK(sim13.getRhsEvaluations() == 370);
+  }
+
+  SUBCASE("run<Symplectic> keeps the logarithmic coordinates") {
+    sim13.setMethod(pf::Method::Symplectic);
+    sim13.setRecordStride(100);
+    sim13.runSimulation(500);
+
+    const pf::Coefficients k{1.1, 0.4, 0.1, 0.4};
+    double u = std::log(80.0), v = std::log(20.0);
+    for (int i = 0; i < 500; ++i)
+      pf::Symplectic::stepLog(k, u, v, 0.001);
+    CHECK(sim13.getx().back() == std::exp(u));
+    CHECK(sim13.gety().back() == std::exp(v));
+    CHECK(sim13.getRhsEvaluations() == 500 * pf::Symplectic::rhsPerStep);
+  }
+}
+
+// Sink di prova che conserva tutti i campioni ricevuti
+struct CollectingSink : pf::TrajectorySink {
+  pf::TrajectoryChunk all;
+  std::size_t chunks = 0;
+  std::size_t largestChunk = 0;
+
+  void consume(const pf::TrajectoryChunk &chunk) override {
+    ++chunks;
+    largestChunk = std::max(largestChunk, chunk.size());
+    for (std::size_t m = 0; m < chunk.size(); ++m) {
+      if (chunk.H.empty())
+        all.push(chunk.t[m], chunk.x[m], chunk.y[m]);
+      else
+        all.push(chunk.t[m], chunk.x[m], chunk.y[m], chunk.H[m]);
+    }
+  }
+};
+
+TEST_CASE("Testing the streaming run mode") {
+  pf::Simulation stored(1.2, 0.5, 0.2, 0.7, 25, 15, 0.001);
+  stored.setUseRK4(true);
+  stored.initializeVectors();
+  stored.runSimulation(10000);
+
+  pf::Simulation streamed(1.2, 0.5, 0.2, 0.7, 25, 15, 0.001);
+  streamed.setUseRK4(true);
+
+  SUBCASE("samples match the stored run, in fixed-size chunks") {
+    CollectingSink sink;
+    streamed.runSimulation(10000, sink, 1000);
+
+    CHECK(sink.all.size() == 10001);
+    CHECK(sink.chunks == 11);
+    CHECK(sink.largestChunk == 1000);
+    CHECK(streamed.getx().empty());
+    CHECK(streamed.gett().empty());
+    CHECK(sink.all.x[0] == stored.getx()[0]);
+    CHECK(sink.all.H[0] == stored.getH()[0]);
+    CHECK(sink.all.x[10000] == stored.getx()[10000]);
+    CHECK(sink.all.y[5000] == stored.gety()[5000]);
+    CHECK(sink.all.H[7777] == stored.getH()[7777]);
+    CHECK(sink.all.t[10000] == stored.gett()[10000]);
+  }
+
+  SUBCASE("consecutive streaming runs continue in time") {
+    CollectingSink sink;
+    streamed.runSimulation(4000, sink, 512);
+    streamed.runSimulation(6000, sink, 512);
+    CHECK(sink.all.size() == 10001);
+    CHECK(sink.all.x[10000] == stored.getx()[10000]);
+    CHECK(sink.all.t[10000] == doctest::Approx(10.0));
+  }
+
+  SUBCASE("statistics and decimation sinks") {
+    pf::StatisticsSink stats;
+    streamed.runSimulation(10000, stats, 256);
+    auto [min_x, max_x] =
+        std::minmax_element(stored.getx().begin(), stored.getx().end());
+    CHECK(stats.getx().min == *min_x);
+    CHECK(stats.getx().max == *max_x);
+    CHECK(stats.getx().count == 10001);
+    CHECK(stats.gety().mean() ==
+          doctest::Approx(std::accumulate(stored.gety().begin(),
+                                          stored.gety().end(), 0.0) /
+                          10001.0));
+
+    pf::DecimatingSink plot(100);
+    pf::Simulation again(1.2, 0.5, 0.2, 0.7, 25, 15, 0.001);
+    again.setUseRK4(true);
+    again.runSimulation(10000, plot, 256);
+    CHECK(plot.getx().size() == 101);
+    CHECK(plot.getx()[37] == stored.getx()[3700]);
+    CHECK(plot.gett()[100] == stored.gett()[10000]);
+  }
+}
+
+TEST_CASE("Testing the asynchronous sink") {
+  pf::Simulation direct(1.2, 0.5, 0.2, 0.7, 25, 15, 0.001);
+  direct.setUseRK4(true);
+  CollectingSink reference;
+  direct.runSimulation(20000, reference, 500);
+
+  pf::Simulation overlapped(1.2, 0.5, 0.2, 0.7, 25, 15, 0.001);
+  overlapped.setUseRK4(true);
+  CollectingSink collected;
+  {
+    pf::AsyncSink async(collected, 3);
+    overlapped.runSimulation(20000, async, 500);
+
+    // runSimulation chiama flush, quindi i blocchi sono gia' stati inoltrati
+    CHECK(collected.all.size() == 20001);
+    overlapped.runSimulation(1000, async, 500);
+  }
+
+  CHECK(collected.all.size() == 21001);
+  CHECK(collected.chunks == reference.chunks + 2);
+  CHECK(std::equal(reference.all.t.begin(), reference.all.t.end(),
+                   collected.all.t.begin()));
+  CHECK(std::equal(reference.all.x.begin(), reference.all.x.end(),
+                   collected.all.x.begin()));
+  CHECK(std::equal(reference.all.y.begin(), reference.all.y.end(),
+                   collected.all.y.begin()));
+  CHECK(std::equal(reference.all.H.begin(), reference.all.H.end(),
+                   collected.all.H.begin()));
+}
+
+TEST_CASE("Testing the live sink") {
+  pf::Simulation stored(1.2, 0.5, 0.2, 0.7, 25, 15, 0.001);
+  stored.setUseRK4(true);
+  stored.initializeVectors();
+  stored.runSimulation(20000);
+
+  pf::Simulation live(1.2, 0.5, 0.2, 0.7, 25, 15, 0.001);
+  live.setUseRK4(true);
+  live.setKeepStreamedData(true);
+
+  SUBCASE("chunks reach the consumer thread and the data is kept") {
+    pf::LiveSink sink(2);
+    std::thread worker([&] {
+      live.runSimulation(20000, sink, 500);
+      sink.finish();
+    });
+
+    CollectingSink received;
+    while (sink.poll([&](const pf::TrajectoryChunk &chunk) {
+      received.consume(chunk);
+    }))
+      std::this_thread::yield();
+    worker.join();
+
+    CHECK(received.all.size() == 20001);
+    CHECK(std::ranges::equal(received.all.x, stored.getx()));
+    CHECK(std::ranges::equal(received.all.t, stored.gett()));
+    CHECK(std::ranges::equal(live.getx(), stored.getx()));
+    CHECK(std::ranges::equal(live.gety(), stored.gety()));
+    CHECK(std::ranges::equal(live.gett(), stored.gett()));
+    CHECK(std::ranges::equal(live.getH(), stored.getH()));
+    CHECK(live.getHStatistics().count == stored.getHStatistics().count);
+    CHECK(live.getxStatistics().mean() ==
+          doctest::Approx(stored.getxStatistics().mean()));
+
+    // Dopo la fine non arriva piu' nulla
+    CHECK_FALSE(sink.poll([](const pf::TrajectoryChunk &) {}));
+  }
+
+  SUBCASE("a closed consumer never blocks the producer") {
+    pf::LiveSink sink(2);
+    std::thread worker([&] {
+      live.runSimulation(20000, sink, 100);
+      sink.finish();
+    });
+    sink.poll([](const pf::TrajectoryChunk &) {});
+    sink.close();
+    worker.join();
+
+    CHECK_FALSE(sink.poll([](const pf::TrajectoryChunk &) {}));
+    CHECK(std::ranges::equal(live.getx(), stored.getx()));
+  }
+}
+
+TEST_CASE("Testing decimated recording with a record stride") {
+  pf::Simulation full(1.1, 0.4, 0.1, 0.4, 80, 20, 0.001);
+  full.setUseRK4(true);
+  full.initializeVectors();
+  full.runSimulation(1000);
+
+  pf::Simulation sim15(1.1, 0.4, 0.1, 0.4, 80, 20, 0.001);
+  sim15.setUseRK4(true);
+  sim15.initializeVectors();
+
+  SUBCASE("every k-th state is stored") {
+    sim15.setRecordStride(10);
+    sim15.runSimulation(1000);
+    CHECK(sim15.getx().size() == 101);
+    CHECK(sim15.gett().size() == 101);
+    CHECK(sim15.getH().size() == 101);
+    CHECK(sim15.getx()[1] == full.getx()[10]);
+    CHECK(sim15.gety()[50] == full.gety()[500]);
+    CHECK(sim15.gett()[100] == full.gett()[1000]);
+  }
+
+  SUBCASE("the stride carries over consecutive runs") {
+    sim15.setOutputInterval(0.025);
+    CHECK(sim15.getRecordStride() == 25);
+    sim15.runSimulation(610);
+    sim15.runSimulation(390);
+    CHECK(sim15.getx().size() == 41);
+    CHECK(sim15.getx()[40] == full.getx()[1000]);
+    CHECK(sim15.gett()[25] == doctest::Approx(0.625));
+  }
+
+  SUBCASE("the streaming mode is decimated too") {
+    pf::Simulation streamed(1.1, 0.4, 0.1, 0.4, 80, 20, 0.001);
+    streamed.setUseRK4(true);
+    streamed.setRecordStride(100);
+    CollectingSink sink;
+    streamed.runSimulation(1000, sink, 4);
+    CHECK(sink.all.size() == 11);
+    CHECK(sink.all.x[3] == full.getx()[300]);
+  }
+}
+
+TEST_CASE("Testing the lazy computation of H") {
+  pf::Simulation sim16(1.1, 0.4, 0.1, 0.4, 80, 20, 0.001);
+  sim16.setUseRK4(true);
+  sim16.initializeVectors();
+  sim16.runSimulation(100);
+
+  SUBCASE("H is materialized on demand and extended after new steps") {
+    CHECK(sim16.getH().size() == 101);
+    CHECK(sim16.getH()[100] ==
+          doctest::Approx(-0.4 * std::log(sim16.getx()[100]) +
+                          0.1 * sim16.getx()[100] + 0.4 * sim16.gety()[100] -
+                          1.1 * std::log(sim16.gety()[100])));
+    sim16.runSimulation(50);
+    CHECK(sim16.getH().size() == 151);
+  }
+
+  SUBCASE("H can be skipped entirely") {
+    sim16.setComputeH(false);
+    sim16.runSimulation(100);
+    CHECK(sim16.getH().empty());
+    CHECK(sim16.getx().size() == 201);
+
+    CollectingSink sink;
+    sim16.runSimulation(10, sink);
+    CHECK(sink.all.size() == 10);
+    CHECK(sink.all.H.empty());
+
+    // L'intestazione nomina le stesse colonne delle righe
+    sim16.writeResults(pf::TextFormat::Fixed, "test_no_h.txt");
+    {
+      pf::FileSink file("test_no_h_stream.txt");
+      sim16.runSimulation(10, file);
+    }
+    for (const char *path : {"test_no_h.txt", "test_no_h_stream.txt"}) {
+      std::ifstream in(path);
+      std::string header, blank, row;
+      std::getline(in, header);
+      std::getline(in, blank);
+      std::getline(in, row);
+      CHECK(header == "TIME\t\tPREY(x)\t\tPREDATOR(y)");
+      CHECK(std::ranges::count(row, '\t') == 2);
+      in.close();
+      std::remove(path);
+    }
+  }
+
+  SUBCASE("extinct states have infinite H") {
+    pf::Simulation sim17(0.6, 2.5, 0.3, 0.5, 8, 12, 0.001);
+    sim17.initializeVectors();
+    sim17.runSimulation(80000);
+    CHECK(sim17.getH().back() == std::numeric_limits<double>::infinity());
+  }
+}
+
+TEST_CASE("Testing the parallel parameter sweep") {
+  pf::SweepSpec spec;
+  spec.A = {1.1, 0.6};
+  spec.B = {0.4, 2.5};
+  spec.C = {0.1, 0.3};
+  spec.D = {0.4, 0.5};
+  spec.x_0 = {8, 80};
+  spec.y_0 = {12, 20};
+  spec.methods = {pf::Method::Euler, pf::Method::RK4};
+  spec.steps = 2000;
+
+  CHECK(spec.numRuns() == 128);
+  CHECK(pf::linspace(0.0, 1.0, 5)[3] == doctest::Approx(0.75));
+
+  auto summaries = pf::runSweep(spec, 4);
+  REQUIRE(summaries.size() == 128);
+
+  SUBCASE("summaries match a serial simulation") {
+    // Indice 1: A = 1.1, B = 0.4, C = 0.1, D = 0.4, x_0 = 8, y_0 = 12, RK4
+    const pf::RunSummary &s = summaries[1];
+    CHECK(s.method == pf::Method::RK4);
+    CHECK(s.x_0 == 8);
+    CHECK(s.y_0 == 12);
+
+    pf::Simulation sim(1.1, 0.4, 0.1, 0.4, 8, 12, 0.001);
+    sim.setUseRK4(true);
+    sim.initializeVectors();
+    sim.runSimulation(2000);
+    auto [min_x, max_x] = std::minmax_element(sim.getx().begin(), sim.getx().end());
+    CHECK(s.x.min == *min_x);
+    CHECK(s.x.max == *max_x);
+    CHECK(s.x.count == 2001);
+    CHECK(s.e2_x == sim.e2_x());
+    CHECK(s.e2_y == sim.e2_y());
+    CHECK(std::isinf(s.extinctionTime));
+  }
+
+  SUBCASE("the extinction time is recorded") {
+    pf::SweepSpec extinct;
+    extinct.A = {0.6};
+    extinct.B = {2.5};
+    extinct.C = {0.3};
+    extinct.D = {0.5};
+    extinct.x_0 = {8};
+    extinct.y_0 = {12};
+    extinct.steps = 80000;
+
+    auto result = pf::runSweep(extinct);
+    REQUIRE(result.size() == 1);
+    CHECK(result[0].extinctionTime > 0.0);
+    CHECK(result[0].extinctionTime < 80.0);
+    CHECK(std::isinf(result[0].maxHDeviation));
+  }
+}
+
+TEST_CASE("Testing single and mixed precision ensembles") {
+  pf::Ensemble ens(0.001);
+  ens.setUseRK4(true);
+  ens.addSystem(1.0, 0.5, 0.2, 0.7, 5, 3);
+  ens.addSystem(1.2, 0.5, 0.2, 0.7, 4, 2);
+
+  SUBCASE("float kernels follow the double path") {
+    pf::EnsembleFloat single(ens);
+    pf::EnsembleMixed mixed(ens);
+    ens.runSimulation(5000);
+    single.runSimulation(5000);
+    mixed.runSimulation(5000);
+    CHECK(single.getx()[0] == doctest::Approx(ens.getx()[0]).epsilon(1e-4));
+    CHECK(single.gety()[1] == doctest::Approx(ens.gety()[1]).epsilon(1e-4));
+    CHECK(mixed.getH()[1] == doctest::Approx(ens.getH()[1]).epsilon(1e-4));
+  }
+
+  SUBCASE("H deviation is tracked like checkHStability") {
+    ens.setTrackHDeviation(true);
+    ens.runSimulation(5000);
+    CHECK(ens.getMaxHDeviation()[0] > 0.0);
+    CHECK(ens.getMaxHDeviation()[0] < 1e-10);
+  }
+
+  SUBCASE("accuracy report") {
+    auto report = pf::writePrecisionReport(ens, 5000, 1e-4);
+    REQUIRE(report.size() == 3);
+    CHECK(report[0].maxStateError == 0.0);
+    CHECK(report[0].stableSystems == 2);
+    CHECK(report[1].maxHDeviation > report[0].maxHDeviation);
+    CHECK(report[1].maxStateError < 1e-3);
+    CHECK(report[2].maxStateError < 1e-3);
+    CHECK(report[2].stableSystems <= 2);
+    std::remove("Precision_Report.txt");
+  }
+}
+
+TEST_CASE("Testing orbit closure detection and periodic fast-forward") {
+  pf::Simulation integrated(1.0, 0.5, 0.2, 0.7, 5, 3, 0.001);
+  integrated.setUseRK4(true);
+  integrated.initializeVectors();
+  integrated.runSimulation(100000);
+
+  pf::Simulation periodic(1.0, 0.5, 0.2, 0.7, 5, 3, 0.001);
+  periodic.setUseRK4(true);
+  periodic.setPeriodicFastForward(true);
+  periodic.initializeVectors();
+
+  SUBCASE("the replayed samples match the integrated ones") {
+    periodic.runSimulation(100000);
+    CHECK(periodic.getPeriod() > 0.0);
+    CHECK(periodic.getx().size() == 100001);
+    CHECK(periodic.gett()[100000] == integrated.gett()[100000]);
+    for (std::size_t i : {20000u, 55555u, 99999u, 100000u}) {
+      CHECK(periodic.getx()[i] ==
+            doctest::Approx(integrated.getx()[i]).epsilon(1e-7));
+      CHECK(periodic.gety()[i] ==
+            doctest::Approx(integrated.gety()[i]).epsilon(1e-7));
+    }
+    // Circa un periodo di integrazione invece di 100 unita' di tempo
+    CHECK(periodic.getRhsEvaluations() < 4 * 100000 / 5);
+  }
+
+  SUBCASE("the fast-forward continues over later runs and strides") {
+    periodic.runSimulation(30000);
+    periodic.setRecordStride(100);
+    periodic.runSimulation(70000);
+    CHECK(periodic.getx().size() == 30001 + 700);
+    CHECK(periodic.getx().back() ==
+          doctest::Approx(integrated.getx()[100000]).epsilon(1e-7));
+  }
+
+  SUBCASE("symplectic states are unchanged until the orbit closes") {
+    pf::Simulation plain(1.0, 0.5, 0.2, 0.7, 5, 3, 0.001);
+    plain.setMethod(pf::Method::Symplectic);
+    plain.initializeVectors();
+    plain.runSimulation(30000);
+
+    pf::Simulation symplectic(1.0, 0.5, 0.2, 0.7, 5, 3, 0.001);
+    symplectic.setMethod(pf::Method::Symplectic);
+    symplectic.setPeriodicFastForward(true);
+    symplectic.initializeVectors();
+    symplectic.runSimulation(30000);
+    REQUIRE(symplectic.getPeriod() > 0.0);
+
+    // Prima di un periodo l'orbita non puo' essersi chiusa: gli stati sono
+    // quelli integrati, bit per bit
+    auto integratedSteps = static_cast<std::size_t>(
+        symplectic.getPeriod() / 0.001);
+    CHECK(std::ranges::equal(symplectic.getx().first(integratedSteps),
+                             plain.getx().first(integratedSteps)));
+    CHECK(std::ranges::equal(symplectic.gety().first(integratedSteps),
+                             plain.gety().first(integratedSteps)));
+    CHECK(symplectic.getx()[29999] ==
+          doctest::Approx(plain.getx()[29999]).epsilon(1e-7));
+  }
+
+  SUBCASE("an open orbit is never fast-forwarded") {
+    pf::Simulation euler(1.0, 0.5, 0.2, 0.7, 5, 3, 0.001);
+    euler.setPeriodicFastForward(true, 1e-9);
+    euler.initializeVectors();
+    euler.runSimulation(50000);
+    CHECK(euler.getPeriod() == 0.0);
+    CHECK(euler.getRhsEvaluations() == 50000);
+  }
+}
+
+TEST_CASE("Testing the binary columnar trajectory format") {
+  pf::Simulation sim18(1.1, 0.4, 0.1, 0.4, 80, 20, 0.001);
+  sim18.setUseRK4(true);
+  sim18.initializeVectors();
+  sim18.runSimulation(1000);
+  sim18.writeResultsBinary("test_trajectory.bin");
+
+  SUBCASE("reading back gives the exact values") {
+    pf::BinaryTrajectory traj = pf::readBinaryTrajectory("test_trajectory.bin");
+    CHECK(traj.header.count == 1001);
+    CHECK(traj.header.method == static_cast<std::uint32_t>(pf::Method::RK4));
+    CHECK(traj.header.A == 1.1);
+    CHECK(traj.header.x_0 == 80);
+    CHECK(traj.header.dt == 0.001);
+    CHECK(std::ranges::equal(traj.t, sim18.gett()));
+    CHECK(std::ranges::equal(traj.x, sim18.getx()));
+    CHECK(std::ranges::equal(traj.y, sim18.gety()));
+    CHECK(std::ranges::equal(traj.H, sim18.getH()));
+  }
+
+  SUBCASE("the file can be memory-mapped") {
+    pf::MappedTrajectory mapped("test_trajectory.bin");
+    CHECK(mapped.header().count == 1001);
+    CHECK(mapped.x().size() == 1001);
+    CHECK(mapped.x()[500] == sim18.getx()[500]);
+    CHECK(mapped.H()[1000] == sim18.getH()[1000]);
+    CHECK(mapped.t()[1000] == sim18.gett()[1000]);
+  }
+
+  SUBCASE("invalid files are rejected") {
+    CHECK_THROWS_AS(pf::readBinaryTrajectory("missing.bin"), std::runtime_error);
+    std::ofstream("not_a_trajectory.bin") << "testo";
+    CHECK_THROWS_AS(pf::MappedTrajectory("not_a_trajectory.bin"),
+                    std::runtime_error);
+    std::remove("not_a_trajectory.bin");
+
+    // Un count enorme non deve superare il controllo per overflow
+    pf::BinaryTrajectoryHeader header = pf::makeBinaryHeader();
+    header.hasH = 1;
+    header.count = std::uint64_t{1} << 62;
+    std::ofstream("crafted.bin", std::ios::binary)
+        .write(reinterpret_cast<const char *>(&header), sizeof header);
+    CHECK_THROWS_AS(pf::MappedTrajectory("crafted.bin"), std::runtime_error);
+    CHECK_THROWS_AS(pf::readBinaryTrajectory("crafted.bin"),
+                    std::runtime_error);
+    std::remove("crafted.bin");
+  }
+
+  SUBCASE("strides and write errors are not silently lost") {
+    CHECK(pf::binaryStride(4294967295u) == 4294967295u);
+    CHECK_THROWS_AS(pf::binaryStride(std::size_t{1} << 32),
+                    std::invalid_argument);
+    pf::Simulation sparse(1.1, 0.4, 0.1, 0.4, 80, 20, 0.001);
+    sparse.setRecordStride(std::size_t{1} << 32);
+    sparse.initializeVectors();
+    sparse.runSimulation(10);
+    CHECK_THROWS_AS(sparse.writeResultsBinary("test_sparse.bin"),
+                    std::invalid_argument);
+
+    CHECK_THROWS_AS(pf::writeBinaryTrajectory("missing_dir/out.bin",
+                                              pf::makeBinaryHeader(),
+                                              sim18.gett(), sim18.getx(),
+                                              sim18.gety(), sim18.getH()),
+                    std::runtime_error);
+    CHECK_THROWS_AS(sim18.writeResultsCompressed("missing_dir/out.lvz", 32),
+                    std::runtime_error);
+  }
+
+  std::remove("test_trajectory.bin");
+}
+
+TEST_CASE("Testing the fast text writer") {
+  const std::vector<double> values = {0.0,     -0.0,   1.0,      -2.5,
+                                      1e-7,    5e-7,   0.1234565, 123456.789,
+                                      1e20,    -3e-12, 2.0 / 3.0, 1e300};
+
+  SUBCASE("Fixed format matches iostream output") {
+    {
+      pf::TextWriter writer("test_text_writer.txt", pf::TextFormat::Fixed, 64);
+      writer.write("HEADER\n");
+      for (std::size_t m = 0; m + 3 < values.size(); ++m)
+        writer.writeRow(values[m], values[m + 1], values[m + 2], values[m + 3]);
+      writer.writeRow(values[0], values[5], values[10]);
+    }
+
+    std::ostringstream expected;
+    expected << std::fixed << std::setprecision(6) << "HEADER\n";
+    for (std::size_t m = 0; m + 3 < values.size(); ++m)
+      expected << values[m] << "\t" << values[m + 1] << "\t" << values[m + 2]
+               << "\t" << values[m + 3] << "\n";
+    expected << values[0] << "\t" << values[5] << "\t" << values[10] << "\n";
+
+    std::ifstream in("test_text_writer.txt");
+    std::stringstream written;
+    written << in.rdbuf();
+    CHECK(written.str() == expected.str());
+  }
+
+  SUBCASE("Shortest format reads back the same values") {
+    {
+      pf::TextWriter writer("test_text_writer.txt", pf::TextFormat::Shortest);
+      for (std::size_t m = 0; m + 3 < values.size(); ++m)
+        writer.writeRow(values[m], values[m + 1], values[m + 2], values[m + 3]);
+    }
+
+    std::ifstream in("test_text_writer.txt");
+    for (std::size_t m = 0; m + 3 < values.size(); ++m) {
+      double row[4];
+      in >> row[0] >> row[1] >> row[2] >> row[3];
+      for (std::size_t k = 0; k < 4; ++k)
+        CHECK(row[k] == values[m + k]);
+    }
+  }
+
+  std::remove("test_text_writer.txt");
+}
+
+TEST_CASE("Testing the compressed trajectory store") {
+  pf::Simulation sim19(1.2, 0.5, 0.2, 0.7, 25, 15, 0.001);
+  sim19.setUseRK4(true);
+  sim19.initializeVectors();
+  sim19.runSimulation(20000);
+
+  SUBCASE("lossless compression in memory") {
+    pf::CompressedSink sink;
+    pf::Simulation streamed(1.2, 0.5, 0.2, 0.7, 25, 15, 0.001);
+    streamed.setUseRK4(true);
+    streamed.runSimulation(20000, sink);
+
+    const pf::CompressedTrajectory &compressed = sink.get();
+    CHECK(compressed.size() == 20001);
+    CHECK(compressed.hasH());
+    CHECK(compressed.sizeBytes() * 3 < 4 * 20001 * sizeof(double));
+
+    pf::TrajectoryChunk decoded = compressed.decode();
+    CHECK(std::ranges::equal(decoded.t, sim19.gett()));
+    CHECK(std::ranges::equal(decoded.x, sim19.getx()));
+    CHECK(std::ranges::equal(decoded.y, sim19.gety()));
+    CHECK(std::ranges::equal(decoded.H, sim19.getH()));
+
+    CollectingSink replayed;
+    compressed.replay(replayed, 3000);
+    CHECK(replayed.chunks == 7);
+    CHECK(std::ranges::equal(replayed.all.x, sim19.getx()));
+    CHECK(std::ranges::equal(replayed.all.t, sim19.gett()));
+  }
+
+  SUBCASE("lossy compression keeps the requested precision") {
+    pf::CompressedTrajectory compressed(24);
+    for (std::size_t m = 0; m < sim19.getx().size(); ++m)
+      compressed.push(sim19.gett()[m], sim19.getx()[m], sim19.gety()[m]);
+    CHECK_FALSE(compressed.hasH());
+    CHECK(compressed.sizeBytes() * 6 < 3 * 20001 * sizeof(double));
+
+    pf::TrajectoryChunk decoded = compressed.decode();
+    CHECK(std::ranges::equal(decoded.t, sim19.gett()));
+    CHECK(decoded.H.empty());
+    for (std::size_t m = 0; m < decoded.size(); m += 97) {
+      CHECK(std::abs(decoded.x[m] - sim19.getx()[m]) <=
+            std::ldexp(sim19.getx()[m], -24));
+      CHECK(std::abs(decoded.y[m] - sim19.gety()[m]) <=
+            std::ldexp(sim19.gety()[m], -24));
+    }
+  }
+
+  SUBCASE("32 mantissa bits give at least 5x with a 2^-33 error") {
+    sim19.writeResultsCompressed("test_lossy.lvz", 32);
+    pf::CompressedTrajectory read =
+        pf::readCompressedTrajectory("test_lossy.lvz");
+    CHECK(read.getx().getMantissaBits() == 32);
+    CHECK(read.sizeBytes() * 5 <= 4 * 20001 * sizeof(double));
+    CHECK(std::filesystem::file_size("test_lossy.lvz") * 5 <=
+          4 * 20001 * sizeof(double));
+    std::remove("test_lossy.lvz");
+
+    // L'arrotondamento a 32 bit di mantissa sposta ogni valore al piu' di
+    // mezza unita' dell'ultimo bit conservato
+    pf::TrajectoryChunk decoded = read.decode();
+    CHECK(std::ranges::equal(decoded.t, sim19.gett()));
+    double worst = 0.0;
+    for (std::size_t m = 0; m < decoded.size(); ++m) {
+      worst = std::max(worst, std::abs(decoded.x[m] - sim19.getx()[m]) /
+                                  std::abs(sim19.getx()[m]));
+      worst = std::max(worst, std::abs(decoded.y[m] - sim19.gety()[m]) /
+                                  std::abs(sim19.gety()[m]));
+      worst = std::max(worst, std::abs(decoded.H[m] - sim19.getH()[m]) /
+                                  std::abs(sim19.getH()[m]));
+    }
+    CHECK(worst > 0.0);
+    CHECK(worst <= std::ldexp(1.0, -33));
+  }
+
+  SUBCASE("special values are preserved") {
+    const std::vector<double> values = {
+        0.0, -0.0, 1.0, 1e300, -1e-300, 4.9e-324,
+        std::numeric_limits<double>::infinity(), 2.0, 3.0, 4.0};
+    pf::CompressedColumn column;
+    for (double v : values)
+      column.push(v);
+    column.push(std::numeric_limits<double>::quiet_NaN());
+
+    std::vector<double> decoded = column.decode();
+    CHECK(std::equal(values.begin(), values.end(), decoded.begin()));
+    CHECK(std::signbit(decoded[1]));
+    CHECK(std::isnan(decoded.back()));
+  }
+
+  SUBCASE("writing and reading a compressed file") {
+    sim19.writeResultsCompressed("test_trajectory.lvz");
+
+    pf::BinaryTrajectoryHeader header{};
+    pf::CompressedTrajectory read =
+        pf::readCompressedTrajectory("test_trajectory.lvz", &header);
+    CHECK(header.count == 20001);
+    CHECK(header.A == 1.2);
+    CHECK(header.dt == 0.001);
+    pf::TrajectoryChunk decoded = read.decode();
+    CHECK(std::ranges::equal(decoded.x, sim19.getx()));
+    CHECK(std::ranges::equal(decoded.H, sim19.getH()));
+
+    CHECK_THROWS_AS(pf::readCompressedTrajectory("missing.lvz"),
+                    std::runtime_error);
+
+    // File troncato
+    std::ifstream whole("test_trajectory.lvz", std::ios::binary);
+    std::string bytes((std::istreambuf_iterator<char>(whole)),
+                      std::istreambuf_iterator<char>());
+    whole.close();
+    std::ofstream("test_truncated.lvz", std::ios::binary)
+        .write(bytes.data(), static_cast<std::streamsize>(bytes.size() / 2));
+    CHECK_THROWS_AS(pf::readCompressedTrajectory("test_truncated.lvz"),
+                    std::runtime_error);
+    std::remove("test_truncated.lvz");
+    std::remove("test_trajectory.lvz");
+  }
+
+  SUBCASE("corrupt columns are rejected while decoding") {
+    // Finestra di 127 bit: zeri iniziali 63, lunghezza 64
+    pf::CompressedColumn wide(3, 52, 1, 64, {~std::uint64_t{0}});
+    CHECK_THROWS_AS(wide.decode(), std::runtime_error);
+
+    // Piu' campioni dei bit disponibili
+    pf::CompressedColumn shortColumn(1, 52, 5, 3, {0});
+    CHECK_THROWS_AS(shortColumn.decode(), std::runtime_error);
+  }
+}
+
+TEST_CASE("Testing the online statistics") {
+  pf::Simulation stored(1.2, 0.5, 0.2, 0.7, 25, 15, 0.001);
+  stored.setUseRK4(true);
+  stored.initializeVectors();
+  stored.runSimulation(20000);
+
+  // Statistiche calcolate con due passaggi sui dati salvati
+  auto twoPass = [](std::span<const double> v) {
+    double mean = std::accumulate(v.begin(), v.end(), 0.0) /
+                  static_cast<double>(v.size());
+    double sq = 0.0;
+    for (double value : v)
+      sq += (value - mean) * (value - mean);
+    return std::pair{mean, sq / static_cast<double>(v.size())};
+  };
+
+  auto [mean_x, var_x] = twoPass(stored.getx());
+  auto [mean_H, var_H] = twoPass(stored.getH());
+  const pf::RunningStats &sx = stored.getxStatistics();
+  CHECK(sx.count == 20001);
+  CHECK(sx.min == *std::min_element(stored.getx().begin(), stored.getx().end()));
+  CHECK(sx.max == *std::max_element(stored.getx().begin(), stored.getx().end()));
+  CHECK(sx.mean() == doctest::Approx(mean_x).epsilon(1e-12));
+  CHECK(sx.variance() == doctest::Approx(var_x).epsilon(1e-9));
+  CHECK(stored.getHStatistics().count == 20001);
+  CHECK(stored.getHStatistics().mean() == doctest::Approx(mean_H));
+
+  SUBCASE("streaming runs produce the same statistics") {
+    pf::Simulation streamed(1.2, 0.5, 0.2, 0.7, 25, 15, 0.001);
+    streamed.setUseRK4(true);
+    pf::StatisticsSink sink;
+    streamed.runSimulation(20000, sink, 333);
+
+    CHECK(streamed.getx().empty());
+    CHECK(streamed.getxStatistics().count == 20001);
+    CHECK(streamed.getxStatistics().variance() == sx.variance());
+    CHECK(streamed.getyStatistics().mean() ==
+          stored.getyStatistics().mean());
+    CHECK(streamed.getHStatistics().max == stored.getHStatistics().max);
+    CHECK(sink.getx().variance() == sx.variance());
+
+    streamed.computeStatistics();
+    std::ifstream in("Statistics.txt");
+    std::stringstream written;
+    written << in.rdbuf();
+    CHECK(written.str().find("Varianza") != std::string::npos);
+    CHECK(written.str().find("Integrale del moto") != std::string::npos);
+    in.close();
+    std::remove("Statistics.txt");
+  }
+
+  SUBCASE("merging partial statistics") {
+    pf::RunningStats first, second, all;
+    for (std::size_t m = 0; m < stored.gety().size(); ++m) {
+      (m < 7000 ? first : second).push(stored.gety()[m]);
+      all.push(stored.gety()[m]);
+    }
+    first.merge(second);
+    CHECK(first.count == all.count);
+    CHECK(first.min == all.min);
+    CHECK(first.max == all.max);
+    CHECK(first.mean() == doctest::Approx(all.mean()).epsilon(1e-12));
+    CHECK(first.variance() == doctest::Approx(all.variance()).epsilon(1e-9));
+  }
+
+  SUBCASE("disabling H drops its statistics") {
+    stored.setComputeH(false);
+    CHECK(stored.getHStatistics().count == 0);
+  }
+
+  SUBCASE("non-finite values are counted apart") {
+    pf::RunningStats stats, other;
+    for (double value : {1.0, 2.0, std::numeric_limits<double>::infinity(),
+                         3.0, std::numeric_limits<double>::quiet_NaN()})
+      stats.push(value);
+    CHECK(stats.count == 3);
+    CHECK(stats.nonFinite == 2);
+    CHECK(stats.max == 3.0);
+    CHECK(stats.mean() == 2.0);
+    CHECK(stats.variance() == doctest::Approx(2.0 / 3.0));
+
+    other.push(-std::numeric_limits<double>::infinity());
+    other.merge(stats);
+    CHECK(other.count == 3);
+    CHECK(other.nonFinite == 3);
+    CHECK(other.mean() == 2.0);
+
+    pf::writeStatistics("test_nonfinite_stats.txt", stats, stats, other);
+    std::ifstream in("test_nonfinite_stats.txt");
+    std::stringstream written;
+    written << in.rdbuf();
+    CHECK(written.str().find("nan") == std::string::npos);
+    CHECK(written.str().find("Valori non finiti (esclusi): 3") !=
+          std::string::npos);
+    in.close();
+    std::remove("test_nonfinite_stats.txt");
+  }
+}
+
+TEST_CASE("Testing the live H-drift monitor") {
+  // Con Euler esplicito H deriva rapidamente
+  pf::Simulation reference(1.2, 0.5, 0.2, 0.7, 25, 15, 0.01);
+  reference.initializeVectors();
+  reference.runSimulation(2000);
+  std::span<const double> H = reference.getH();
+  std::size_t firstViolation = 0;
+  while (std::fabs(H[firstViolation] - H[0]) / std::fabs(H[0]) <= 1e-3)
+    ++firstViolation;
+  REQUIRE(firstViolation < 2000);
+
+  SUBCASE("reporting does not change the run") {
+    pf::Simulation sim(1.2, 0.5, 0.2, 0.7, 25, 15, 0.01);
+    sim.setDriftMonitor(true, 1e-3, pf::DriftAction::Report);
+    sim.initializeVectors();
+    sim.runSimulation(2000);
+
+    const pf::DriftReport &report = sim.getDriftReport();
+    CHECK(report.violated);
+    CHECK(report.violationStep == static_cast<long long>(firstViolation));
+    CHECK(report.violationTime == doctest::Approx(0.01 * static_cast<double>(firstViolation)));
+    CHECK(report.maxDeviation > 1e-3);
+    CHECK(std::ranges::equal(sim.getx(), reference.getx()));
+    CHECK(sim.getStepCount() == 2000);
+  }
+
+  SUBCASE("stopping at the first violation") {
+    pf::Simulation sim(1.2, 0.5, 0.2, 0.7, 25, 15, 0.01);
+    sim.setDriftMonitor(true, 1e-3, pf::DriftAction::Stop);
+    sim.initializeVectors();
+    sim.runSimulation(2000);
+
+    CHECK(sim.getDriftReport().violated);
+    CHECK(sim.getStepCount() == static_cast<long long>(firstViolation));
+    CHECK(sim.getx().size() == firstViolation + 1);
+    CHECK(sim.getx().back() == reference.getx()[firstViolation]);
+    CHECK(sim.getRhsEvaluations() ==
+          static_cast<long long>(firstViolation) * pf::Euler::rhsPerStep);
+
+    pf::Simulation streamed(1.2, 0.5, 0.2, 0.7, 25, 15, 0.01);
+    streamed.setDriftMonitor(true, 1e-3, pf::DriftAction::Refine);
+    CollectingSink sink;
+    streamed.runSimulation(2000, sink, 100);
+    CHECK(sink.all.size() == firstViolation + 1);
+  }
+
+  SUBCASE("refining the time step") {
+    pf::Simulation sim(1.2, 0.5, 0.2, 0.7, 25, 15, 0.01);
+    sim.setUseRK4(true);
+    sim.setDriftMonitor(true, 1e-9, pf::DriftAction::Refine, 6);
+    sim.initializeVectors();
+    sim.runSimulation(2000);
+
+    const pf::DriftReport &report = sim.getDriftReport();
+    CHECK_FALSE(report.violated);
+    CHECK(report.refinements > 0);
+    CHECK(report.maxDeviation <= 1e-9);
+    CHECK(report.dt == doctest::Approx(0.01 / (1 << report.refinements)));
+    // Stessa durata e stessi istanti salvati
+    CHECK(sim.gett().size() == 2001);
+    CHECK(sim.gett().back() == doctest::Approx(20.0));
+    CHECK(sim.getxStatistics().count == 2001);
+
+    pf::Simulation fine(1.2, 0.5, 0.2, 0.7, 25, 15, report.dt);
+    fine.setUseRK4(true);
+    fine.initializeVectors();
+    fine.runSimulation(2000 << report.refinements);
+    CHECK(sim.getx().back() == fine.getx().back());
+
+    // Il passo di registrazione impostato non cambia
+    CHECK(sim.getRecordStride() == 1);
+  }
+
+  SUBCASE("giving up after the maximum number of refinements") {
+    pf::Simulation sim(1.2, 0.5, 0.2, 0.7, 25, 15, 0.01);
+    sim.setDriftMonitor(true, 1e-6, pf::DriftAction::Refine, 2);
+    sim.initializeVectors();
+    sim.runSimulation(2000);
+
+    CHECK(sim.getDriftReport().violated);
+    CHECK(sim.getDriftReport().refinements == 2);
+    CHECK(sim.getx().size() < 2001);
+  }
+
+  SUBCASE("giving up when the doubled step count does not fit") {
+    pf::Simulation sim(1.2, 0.5, 0.2, 0.7, 25, 15, 0.01);
+    sim.setRecordStride(std::size_t{1} << 20);
+    sim.setDriftMonitor(true, 1e-3, pf::DriftAction::Refine);
+    sim.initializeVectors();
+    sim.runSimulation(std::numeric_limits<int>::max() / 2 + 1);
+
+    CHECK(sim.getDriftReport().violated);
+    CHECK(sim.getDriftReport().refinements == 0);
+    CHECK(sim.getStepCount() == static_cast<long long>(firstViolation));
+    CHECK(sim.getRecordStride() == std::size_t{1} << 20);
+  }
+}
+
+TEST_CASE("Testing checkpoint and resume") {
+  // L'ultimo checkpoint periodico (ogni 1700 passi) cade a meta' della
+  // simulazione: riprendendo da li' si simula un'interruzione al passo 3400
+  auto check = [](pf::Method method, bool fastForward) {
+    pf::Simulation full(1.0, 0.5, 0.2, 0.7, 5, 3, 0.005);
+    full.setMethod(method);
+    full.setRecordStride(3);
+    full.setPeriodicFastForward(fastForward);
+    full.initializeVectors();
+    full.runSimulation(5000);
+
+    pf::Simulation interrupted(1.0, 0.5, 0.2, 0.7, 5, 3, 0.005);
+    interrupted.setMethod(method);
+    interrupted.setRecordStride(3);
+    interrupted.setPeriodicFastForward(fastForward);
+    interrupted.setCheckpointInterval(1700, "test_checkpoint.bin");
+    interrupted.initializeVectors();
+    interrupted.runSimulation(5000);
+    CHECK(std::ranges::equal(interrupted.getx(), full.getx()));
+
+    pf::Simulation resumed(1, 1, 1, 1, 1, 1, 1);
+    resumed.loadCheckpoint("test_checkpoint.bin");
+    CHECK(resumed.getStepCount() == 3400);
+    CHECK(resumed.getx().size() < full.getx().size());
+    resumed.resumeSimulation();
+
+    CHECK(resumed.getStepCount() == full.getStepCount());
+    CHECK(resumed.getRhsEvaluations() == full.getRhsEvaluations());
+    CHECK(std::ranges::equal(resumed.gett(), full.gett()));
+    CHECK(std::ranges::equal(resumed.getx(), full.getx()));
+    CHECK(std::ranges::equal(resumed.gety(), full.gety()));
+    CHECK(std::ranges::equal(resumed.getH(), full.getH()));
+    CHECK(resumed.getxStatistics().m2 == full.getxStatistics().m2);
+    CHECK(resumed.getPeriod() == full.getPeriod());
+    CHECK((full.getPeriod() > 0.0) == fastForward);
+
+    // Dopo la ripresa la simulazione prosegue come quella originale
+    full.runSimulation(1000);
+    resumed.runSimulation(1000);
+    CHECK(std::ranges::equal(resumed.getx(), full.getx()));
+  };
+
+  SUBCASE("fixed step methods") {
+    check(pf::Method::Euler, false);
+    check(pf::Method::RK4, false);
+    check(pf::Method::Symplectic, false);
+  }
+
+  SUBCASE("periodic fast-forward") { check(pf::Method::RK4, true); }
+
+  SUBCASE("adaptive method") {
+    pf::Simulation full(1.2, 0.5, 0.2, 0.7, 25, 15, 0.002);
+    full.setMethod(pf::Method::DormandPrince);
+    full.initializeVectors();
+    full.runSimulation(20000);
+
+    pf::Simulation interrupted(1.2, 0.5, 0.2, 0.7, 25, 15, 0.002);
+    interrupted.setMethod(pf::Method::DormandPrince);
+    interrupted.setCheckpointInterval(100, "test_checkpoint.bin");
+    interrupted.initializeVectors();
+    interrupted.runSimulation(20000);
+
+    pf::Simulation resumed(1, 1, 1, 1, 1, 1, 1);
+    resumed.loadCheckpoint("test_checkpoint.bin");
+    CHECK(resumed.getStepCount() % 100 == 0);
+    resumed.resumeSimulation();
+    CHECK(std::ranges::equal(resumed.gett(), full.gett()));
+    CHECK(std::ranges::equal(resumed.getx(), full.getx()));
+    CHECK(std::ranges::equal(resumed.gety(), full.gety()));
+  }
+
+  SUBCASE("streaming runs") {
+    pf::Simulation interrupted(1.2, 0.5, 0.2, 0.7, 25, 15, 0.002);
+    interrupted.setUseRK4(true);
+    interrupted.setCheckpointInterval(1700, "test_checkpoint.bin");
+    CollectingSink all;
+    interrupted.runSimulation(5000, all, 1000);
+
+    pf::Simulation resumed(1, 1, 1, 1, 1, 1, 1);
+    resumed.loadCheckpoint("test_checkpoint.bin");
+    CollectingSink rest;
+    resumed.resumeSimulation(rest, 1000);
+
+    std::ptrdiff_t before = 3401;
+    REQUIRE(rest.all.size() == all.all.size() - 3401);
+    CHECK(std::equal(rest.all.x.begin(), rest.all.x.end(),
+                     all.all.x.begin() + before));
+    CHECK(std::equal(rest.all.t.begin(), rest.all.t.end(),
+                     all.all.t.begin() + before));
+    CHECK(std::equal(rest.all.H.begin(), rest.all.H.end(),
+                     all.all.H.begin() + before));
+  }
+
+  SUBCASE("periodic checkpoints only append the new samples") {
+    pf::Simulation sim(1.2, 0.5, 0.2, 0.7, 25, 15, 0.002);
+    sim.setUseRK4(true);
+    sim.setCheckpointInterval(1000, "test_checkpoint.bin");
+    sim.initializeVectors();
+    sim.runSimulation(2000);
+    auto small = std::filesystem::file_size("test_checkpoint.bin");
+    sim.runSimulation(8000);
+
+    // Lo stato non cresce con la durata, le colonne contengono i campioni
+    // fino all'ultimo checkpoint
+    CHECK(std::filesystem::file_size("test_checkpoint.bin") == small);
+    CHECK(std::filesystem::file_size("test_checkpoint.bin.x.col") ==
+          10001 * sizeof(double));
+
+    pf::Simulation resumed(1, 1, 1, 1, 1, 1, 1);
+    resumed.loadCheckpoint("test_checkpoint.bin");
+    CHECK(std::ranges::equal(resumed.getx(), sim.getx()));
+    CHECK(std::ranges::equal(resumed.gett(), sim.gett()));
+  }
+
+  SUBCASE("refined runs rewrite the discarded samples") {
+    for (pf::Method method : {pf::Method::RK4, pf::Method::DormandPrince}) {
+      pf::Simulation full(1.2, 0.5, 0.2, 0.7, 25, 15, 0.01);
+      full.setMethod(method);
+      full.setDriftMonitor(true, 1e-9, pf::DriftAction::Refine, 6);
+      full.initializeVectors();
+      full.runSimulation(2000);
+      REQUIRE(full.getDriftReport().refinements > 0);
+
+      pf::Simulation interrupted(1.2, 0.5, 0.2, 0.7, 25, 15, 0.01);
+      interrupted.setMethod(method);
+      interrupted.setDriftMonitor(true, 1e-9, pf::DriftAction::Refine, 6);
+      interrupted.setCheckpointInterval(20, "test_checkpoint.bin");
+      interrupted.initializeVectors();
+      interrupted.runSimulation(2000);
+
+      pf::Simulation resumed(1, 1, 1, 1, 1, 1, 1);
+      resumed.loadCheckpoint("test_checkpoint.bin");
+      resumed.resumeSimulation();
+      CHECK(std::ranges::equal(resumed.getx(), full.getx()));
+      CHECK(std::ranges::equal(resumed.gett(), full.gett()));
+    }
+  }
+
+  SUBCASE("a failing sink does not leave the flush hook behind") {
+    struct FailingSink : pf::TrajectorySink {
+      void consume(const pf::TrajectoryChunk &) override {
+        throw std::runtime_error("disco pieno");
+      }
+    } failing;
+    pf::Simulation sim(1.2, 0.5, 0.2, 0.7, 25, 15, 0.002);
+    sim.setCheckpointInterval(100, "test_checkpoint.bin");
+    CHECK_THROWS_AS(sim.runSimulation(1000, failing, 50), std::runtime_error);
+
+    // Un'esecuzione memorizzata successiva salva i checkpoint senza usare il
+    // sink ormai distrutto
+    sim.initializeVectors();
+    sim.runSimulation(1000);
+    pf::Simulation resumed(1, 1, 1, 1, 1, 1, 1);
+    resumed.loadCheckpoint("test_checkpoint.bin");
+    CHECK(resumed.getStepCount() % 100 == 0);
+    CHECK(resumed.getStepCount() > sim.getStepCount() - 100);
+  }
+
+  SUBCASE("columns written by another object are not extended") {
+    pf::Simulation first(1.2, 0.5, 0.2, 0.7, 25, 15, 0.002);
+    first.initializeVectors();
+    first.runSimulation(500);
+    first.saveCheckpoint("test_checkpoint.bin");
+
+    // Un altro oggetto scrive sullo stesso percorso colonne piu' lunghe
+    pf::Simulation other(1.0, 0.5, 0.2, 0.7, 5, 3, 0.002);
+    other.initializeVectors();
+    other.runSimulation(800);
+    other.saveCheckpoint("test_checkpoint.bin");
+
+    first.runSimulation(500);
+    first.saveCheckpoint("test_checkpoint.bin");
+    pf::Simulation loaded(1, 1, 1, 1, 1, 1, 1);
+    loaded.loadCheckpoint("test_checkpoint.bin");
+    CHECK(std::ranges::equal(loaded.getx(), first.getx()));
+    CHECK(std::ranges::equal(loaded.gett(), first.gett()));
+  }
+
+  SUBCASE("invalid checkpoints are rejected") {
+    pf::Simulation sim(1, 1, 1, 1, 1, 1, 1);
+    CHECK_THROWS_AS(sim.loadCheckpoint("missing_checkpoint.bin"),
+                    std::runtime_error);
+    std::ofstream("test_checkpoint.bin") << "LVCKPT1";
+    CHECK_THROWS_AS(sim.loadCheckpoint("test_checkpoint.bin"),
+                    std::runtime_error);
+
+    // Metodo fuori dall'enumerazione: segue codice iniziale, versione,
+    // intestazione delle colonne e sette double
+    sim.initializeVectors();
+    sim.saveCheckpoint("test_checkpoint.bin");
+    {
+      std::fstream file("test_checkpoint.bin",
+                        std::ios::binary | std::ios::in | std::ios::out);
+      file.seekp(8 + 4 + 4 * 8 + 7 * 8);
+      file.put(9);
+    }
+    CHECK_THROWS_AS(sim.loadCheckpoint("test_checkpoint.bin"),
+                    std::runtime_error);
+
+    // Colonna piu' corta del numero di campioni registrato
+    sim.saveCheckpoint("test_checkpoint.bin");
+    std::filesystem::resize_file("test_checkpoint.bin.x.col", 0);
+    CHECK_THROWS_AS(sim.loadCheckpoint("test_checkpoint.bin"),
+                    std::runtime_error);
+  }
+
+  for (const char *file :
+       {"test_checkpoint.bin", "test_checkpoint.bin.t.col",
+        "test_checkpoint.bin.x.col", "test_checkpoint.bin.y.col",
+        "test_checkpoint.bin.H.col", "Checkpoint.bin", "Checkpoint.bin.t.col",
+        "Checkpoint.bin.x.col", "Checkpoint.bin.y.col", "Checkpoint.bin.H.col"})
+    std::remove(file);
+}
+
+TEST_CASE("Testing the batch command line") {
+  SUBCASE("parsing a single job") {
+    pf::CommandLine cl = pf::parseCommandLine(
+        {"--params", "1.2", "0.5", "0.2", "0.7", "--initial", "25", "15",
+         "--method", "rk4", "--dt", "0.01", "--duration", "20", "--format",
+         "shortest", "--prefix", "out_", "--stride", "5", "--threads", "3"});
+    REQUIRE(cl.jobs.size() == 1);
+    const pf::JobOptions &job = cl.jobs[0];
+    CHECK(job.A == 1.2);
+    CHECK(job.D == 0.7);
+    CHECK(job.y_0 == 15);
+    CHECK(job.method == pf::Method::RK4);
+    CHECK(job.steps() == 2000);
+    CHECK(job.format == pf::OutputFormat::Shortest);
+    CHECK(job.prefix == "out_");
+    CHECK(job.stride == 5);
+    CHECK_FALSE(job.plot);
+    CHECK(cl.threads == 3);
+    CHECK_FALSE(cl.help);
+  }
+
+  SUBCASE("invalid command lines are rejected") {
+    CHECK(pf::parseCommandLine({"--help"}).help);
+    CHECK_THROWS_AS(pf::parseCommandLine({"--params", "1", "2"}),
+                    std::invalid_argument);
+    CHECK_THROWS_AS(pf::parseCommandLine({"--params", "1", "1", "1", "1",
+                                          "--initial", "1", "1"}),
+                    std::invalid_argument); // durata mancante
+    CHECK_THROWS_AS(pf::parseCommandLine({"--method", "leapfrog"}),
+                    std::invalid_argument);
+    CHECK_THROWS_AS(pf::parseCommandLine({"--dt", "0.0x1"}),
+                    std::invalid_argument);
+    CHECK_THROWS_AS(pf::parseCommandLine({"--unknown"}), std::invalid_argument);
+    CHECK_THROWS_AS(pf::parseCommandLine({"--params", "1", "1", "1", "1",
+                                          "--initial", "1", "1", "--duration",
+                                          "1e9", "--dt", "1e-3"}),
+                    std::invalid_argument); // troppi passi per un int
+    CHECK_THROWS_AS(pf::parseCommandLine({"--params", "1", "1", "1", "1",
+                                          "--initial", "1", "1", "--format",
+                                          "binary", "--stride", "4294967296"}),
+                    std::invalid_argument); // stride oltre i 32 bit
+
+    // L'argomento mancante viene indicato anche per --jobs e --threads
+    for (const char *option : {"--jobs", "--threads", "--dt"}) {
+      try {
+        pf::parseCommandLine({option});
+        FAIL("nessuna eccezione");
+      } catch (const std::invalid_argument &error) {
+        CHECK(std::string(error.what()) ==
+              std::string("Argomento mancante per ") + option);
+      }
+    }
+  }
+
+  SUBCASE("the same duration gives the same steps in every mode") {
+    CHECK(pf::stepsFor(20.0, 0.01) == 2000);
+    CHECK(pf::stepsFor(0.3, 0.001) == 300);
+    CHECK_THROWS_AS(pf::stepsFor(1e9, 1e-3), std::invalid_argument);
+  }
+
+  SUBCASE("parsing a job file") {
+    pf::JobOptions defaults;
+    defaults.method = pf::Method::Symplectic;
+    defaults.duration = 5;
+    defaults.prefix = "out/";
+    std::istringstream file("# job di prova\n"
+                            "--params 1 0.5 0.2 0.7 --initial 5 3\n"
+                            "\n"
+                            "--params 1 1 1 1 --initial 2 2 --method dp  # dp\n"
+                            "--params 1 1 1 1 --initial 2 2 --prefix x_\n");
+    std::vector<pf::JobOptions> jobs = pf::parseJobFile(file, defaults);
+    REQUIRE(jobs.size() == 3);
+    CHECK(jobs[0].method == pf::Method::Symplectic);
+    CHECK(jobs[0].prefix == "out/job1_");
+    CHECK(jobs[1].method == pf::Method::DormandPrince);
+    CHECK(jobs[1].duration == 5);
+    CHECK(jobs[1].prefix == "out/job2_");
+    CHECK(jobs[2].prefix == "x_");
+
+    std::istringstream bad("--params 1 1 1 1 --initial 2 2\n--initial 2\n");
+    CHECK_THROWS_WITH_AS(pf::parseJobFile(bad, defaults),
+                         doctest::Contains("Riga 2"), std::invalid_argument);
+  }
+
+  SUBCASE("running jobs without a display") {
+    pf::JobOptions job;
+    job.A = 1.2;
+    job.B = 0.5;
+    job.C = 0.2;
+    job.D = 0.7;
+    job.x_0 = 25;
+    job.y_0 = 15;
+    job.parametersSet = job.initialSet = true;
+    job.method = pf::Method::RK4;
+    job.duration = 10;
+    job.prefix = "test_cli_";
+
+    pf::JobResult result = pf::runJob(job);
+    CHECK(result.stable);
+    CHECK(result.steps == 10000);
+    std::ifstream stability("test_cli_H_Stability.txt");
+    std::string firstLine;
+    std::getline(stability, firstLine);
+    CHECK(firstLine.starts_with("H iniziale: "));
+    stability.close();
+
+    // Il file in streaming coincide con quello di writeResults
+    pf::Simulation sim(1.2, 0.5, 0.2, 0.7, 25, 15, 0.001);
+    sim.setUseRK4(true);
+    sim.initializeVectors();
+    sim.runSimulation(10000);
+    sim.writeResults(pf::TextFormat::Fixed, "test_cli_reference.txt");
+    std::ifstream streamed("test_cli_ValueList.txt");
+    std::ifstream reference("test_cli_reference.txt");
+    std::stringstream a, b;
+    a << streamed.rdbuf();
+    b << reference.rdbuf();
+    CHECK(a.str() == b.str());
+    CHECK(std::ifstream("test_cli_Statistics.txt").good());
+
+    pf::JobOptions indexedJob = job;
+    indexedJob.format = pf::OutputFormat::Indexed;
+    pf::runJob(indexedJob);
+    pf::IndexedTrajectory indexed("test_cli_ValueList.lvi");
+    CHECK(indexed.size() == 10001);
+    CHECK(indexed.header().x_0 == 25);
+    CHECK(indexed.stateAt(10.0).x == sim.getx().back());
+
+    std::vector<pf::JobOptions> jobs(6, job);
+    jobs[5].method = pf::Method::Euler;
+    jobs[5].format = pf::OutputFormat::None;
+    CHECK(pf::runJobs(jobs, 3) == 1);
+
+    // Senza H il job non viene contato come instabile
+    jobs[5].computeH = false;
+    CHECK(pf::runJobs(jobs, 3) == 0);
+
+    for (const char *path :
+         {"test_cli_ValueList.txt", "test_cli_ValueList.lvi",
+          "test_cli_reference.txt", "test_cli_Statistics.txt",
+          "test_cli_H_Stability.txt", "test_cli_e_2Coordinates.txt"})
+      std::remove(path);
+  }
+}
+
+TEST_CASE("Testing memory-mapped storage") {
+  SUBCASE("mapped column") {
+    {
+      pf::MappedColumn column("test_column.col");
+      CHECK(column.isMapped());
+      for (int i = 0; i < 100000; ++i)
+        column.push_back(0.5 * i);
+      CHECK(column.size() == 100000);
+      CHECK(column[99999] == 49999.5);
+
+      // La copia sta in memoria, l'assegnazione conserva il file
+      pf::MappedColumn copy(column);
+      CHECK_FALSE(copy.isMapped());
+      copy.resize(10);
+      column = copy;
+      CHECK(column.isMapped());
+      CHECK(column.size() == 10);
+    }
+
+    // Alla chiusura il file ha la lunghezza esatta dei dati
+    std::ifstream file("test_column.col", std::ios::binary | std::ios::ate);
+    CHECK(file.tellg() == 10 * static_cast<std::streamoff>(sizeof(double)));
+    file.close();
+
+    pf::MappedColumn reopened("test_column.col", false);
+    CHECK(reopened.size() == 10);
+    CHECK(reopened.back() == 4.5);
+    std::remove("test_column.col");
+  }
+
+  SUBCASE("simulation data") {
+    pf::Simulation memory(1.0, 0.5, 0.2, 0.7, 5, 3, 0.005);
+    memory.setMethod(pf::Method::RK4);
+    memory.initializeVectors();
+    memory.runSimulation(1500);
+    memory.runSimulation(1500);
+
+    pf::Simulation mapped(1.0, 0.5, 0.2, 0.7, 5, 3, 0.005);
+    mapped.setMethod(pf::Method::RK4);
+    mapped.initializeVectors();
+    mapped.setMappedStorage("test_mapped_");
+    mapped.runSimulation(1500);
+    mapped.saveCheckpoint("test_checkpoint.bin");
+    mapped.runSimulation(1500);
+
+    CHECK(std::ranges::equal(mapped.gett(), memory.gett()));
+    CHECK(std::ranges::equal(mapped.getx(), memory.getx()));
+    CHECK(std::ranges::equal(mapped.getH(), memory.getH()));
+
+    // Il checkpoint viene caricato nei file mappati
+    mapped.loadCheckpoint("test_checkpoint.bin");
+    mapped.resumeSimulation();
+    mapped.runSimulation(1500);
+    mapped.setMappedStorage("");
+    CHECK(std::ranges::equal(mapped.gety(), memory.gety()));
+
+    pf::MappedColumn y("test_mapped_y.col", false);
+    CHECK(std::ranges::equal(y, memory.gety()));
+    for (const char *path : {"test_mapped_t.col", "test_mapped_x.col",
+                             "test_mapped_y.col", "test_mapped_H.col",
+                             "test_checkpoint.bin"})
+      std::remove(path);
+  }
+}
+
+TEST_CASE("Testing the indexed trajectory file") {
+  pf::Simulation stored(1.2, 0.5, 0.2, 0.7, 25, 15, 0.01);
+  stored.setMethod(pf::Method::RK4);
+  stored.initializeVectors();
+  stored.runSimulation(10000);
+  std::span<const double> t = stored.gett(), x = stored.getx(),
+                          H = stored.getH();
+
+  SUBCASE("queries read only the relevant blocks") {
+    // Blocchi da 1000 campioni: ciascuno copre 10 unita' di tempo
+    stored.writeResultsIndexed("test_indexed.lvi", 1000);
+    pf::IndexedTrajectory indexed("test_indexed.lvi");
+    CHECK(indexed.size() == 10001);
+    CHECK(indexed.blocks().size() == 11);
+    CHECK(indexed.hasH());
+    CHECK(indexed.header().A == 1.2);
+    CHECK(indexed.blocksRead() == 0);
+
+    pf::TrajectoryChunk window = indexed.range(23.456, 31.0);
+    CHECK(indexed.blocksRead() == 2);
+    std::vector<double> expected;
+    for (std::size_t i = 0; i < t.size(); ++i)
+      if (t[i] >= 23.456 && t[i] <= 31.0)
+        expected.push_back(x[i]);
+    CHECK(window.x == expected);
+    CHECK(window.H.size() == expected.size());
+
+    pf::TrajectorySample sample = indexed.stateAt(t[4321]);
+    CHECK(sample.x == x[4321]);
+    CHECK(sample.H == H[4321]);
+    // Tra l'ultimo campione di un blocco e il primo del successivo
+    double middle = 0.5 * (t[999] + t[1000]);
+    CHECK(indexed.stateAt(middle).x ==
+          doctest::Approx(0.5 * (x[999] + x[1000])));
+    CHECK(indexed.stateAt(t.back()).x == x.back());
+    CHECK_THROWS_AS(indexed.stateAt(-1.0), std::out_of_range);
+    CHECK_THROWS_AS(indexed.stateAt(t.back() + 1.0), std::out_of_range);
+
+    // Solo i due blocchi ai bordi vengono letti
+    std::size_t before = indexed.blocksRead();
+    pf::TrajectoryBounds bounds = indexed.extremes(5.0, 75.0);
+    CHECK(indexed.blocksRead() - before == 2);
+    double xMin = std::numeric_limits<double>::infinity(), xMax = -xMin;
+    double HMax = -xMin;
+    for (std::size_t i = 0; i < t.size(); ++i) {
+      if (t[i] >= 5.0 && t[i] <= 75.0) {
+        xMin = std::min(xMin, x[i]);
+        xMax = std::max(xMax, x[i]);
+        HMax = std::max(HMax, H[i]);
+      }
+    }
+    CHECK(bounds.xMin == xMin);
+    CHECK(bounds.xMax == xMax);
+    CHECK(bounds.HMax == HMax);
+    CHECK(std::isnan(indexed.extremes(200.0, 300.0).xMin));
+  }
+
+  SUBCASE("streaming writer") {
+    pf::Simulation streamed(1.2, 0.5, 0.2, 0.7, 25, 15, 0.01);
+    streamed.setMethod(pf::Method::RK4);
+    streamed.setComputeH(false);
+    {
+      pf::IndexedTrajectoryWriter writer("test_indexed.lvi",
+                                         pf::makeBinaryHeader(), 700);
+      streamed.runSimulation(10000, writer, 256);
+    }
+
+    pf::IndexedTrajectory indexed("test_indexed.lvi");
+    CHECK(indexed.size() == 10001);
+    CHECK(indexed.blocks().size() == 15);
+    CHECK_FALSE(indexed.hasH());
+    pf::TrajectoryChunk all = indexed.range(0.0, 1e9);
+    CHECK(std::ranges::equal(all.x, x));
+    CHECK(std::ranges::equal(all.t, t));
+    CHECK(std::isnan(indexed.stateAt(50.0).H));
+  }
+
+  SUBCASE("truncated or corrupt files are rejected") {
+    stored.writeResultsIndexed("test_indexed.lvi", 1000);
+    std::ifstream whole("test_indexed.lvi", std::ios::binary);
+    std::string bytes((std::istreambuf_iterator<char>(whole)),
+                      std::istreambuf_iterator<char>());
+    whole.close();
+
+    // Copia del file con il valore a 64 bit in posizione at sostituito
+    auto patched = [&bytes](std::size_t at, std::uint64_t value) {
+      std::string copy = bytes;
+      std::memcpy(copy.data() + at, &value, sizeof value);
+      std::ofstream("test_corrupt.lvi", std::ios::binary)
+          .write(copy.data(), static_cast<std::streamsize>(copy.size()));
+    };
+    auto rejected = [] {
+      CHECK_THROWS_AS(pf::IndexedTrajectory("test_corrupt.lvi"),
+                      std::runtime_error);
+    };
+
+    std::ofstream("test_corrupt.lvi", std::ios::binary)
+        .write(bytes.data(), static_cast<std::streamsize>(bytes.size() / 2));
+    rejected();
+
+    // Coda: posizione dell'indice, numero di blocchi, codice iniziale
+    std::size_t trailer = bytes.size() - 24;
+    std::uint64_t indexOffset = 0;
+    std::memcpy(&indexOffset, bytes.data() + trailer, sizeof indexOffset);
+    patched(trailer + 8, std::uint64_t{1} << 60);
+    rejected();
+    patched(trailer, ~std::uint64_t{0});
+    rejected();
+
+    // Voce dell'indice: tFirst, tLast, offset, first, count
+    std::size_t entry = static_cast<std::size_t>(indexOffset);
+    patched(entry + 32, std::uint64_t{1} << 61);
+    rejected();
+    patched(entry + 32, 999);
+    rejected();
+    patched(entry + 16, indexOffset - 8);
+    rejected();
+    std::remove("test_corrupt.lvi");
+  }
+
+  std::remove("test_indexed.lvi");
+}
+
+TEST_CASE("Testing plot decimation") {
+  SUBCASE("min/max per pixel column") {
+    std::vector<double> t(200000), v(200000);
+    for (std::size_t i = 0; i < t.size(); ++i) {
+      t[i] = 0.001 * static_cast<double>(i);
+      v[i] = std::sin(t[i]) + (i % 997 == 0 ? 3.0 : 0.0); // picchi isolati
+    }
+    std::vector<std::size_t> kept = pf::decimateMinMax(t, v, 700);
+    CHECK(kept.size() <= 4 * 700);
+    CHECK(kept.front() == 0);
+    CHECK(kept.back() == t.size() - 1);
+    CHECK(std::is_sorted(kept.begin(), kept.end()));
+
+    // Ogni picco resta tra i vertici
+    bool peaksKept = true;
+    for (std::size_t i = 0; i < t.size(); i += 997)
+      peaksKept = peaksKept && std::binary_search(kept.begin(), kept.end(), i);
+    CHECK(peaksKept);
+
+    // Estremi di ogni colonna uguali a quelli dei campioni originali
+    double duration = t.back();
+    std::vector<double> low(700, 1e9), high(700, -1e9), keptLow(700, 1e9),
+        keptHigh(700, -1e9);
+    auto columnOf = [&](std::size_t i) {
+      return std::min<std::size_t>(
+          static_cast<std::size_t>(t[i] / duration * 700.0), 699);
+    };
+    for (std::size_t i = 0; i < t.size(); ++i) {
+      low[columnOf(i)] = std::min(low[columnOf(i)], v[i]);
+      high[columnOf(i)] = std::max(high[columnOf(i)], v[i]);
+    }
+    for (std::size_t i : kept) {
+      keptLow[columnOf(i)] = std::min(keptLow[columnOf(i)], v[i]);
+      keptHigh[columnOf(i)] = std::max(keptHigh[columnOf(i)], v[i]);
+    }
+    CHECK(low == keptLow);
+    CHECK(high == keptHigh);
+
+    // Pochi campioni: nessuna riduzione
+    CHECK(pf::decimateMinMax(std::span(t).first(100), v, 700).size() == 100);
+  }
+
+  SUBCASE("distinct pixel segments of the phase curve") {
+    // Orbita chiusa percorsa molte volte: il numero di segmenti non cresce
+    // con la durata
+    auto segments = [](int steps) {
+      pf::Simulation sim(1.2, 0.5, 0.2, 0.7, 25, 15, 0.001);
+      sim.setMethod(pf::Method::Symplectic);
+      sim.initializeVectors();
+      sim.runSimulation(steps);
+      auto [xMin, xMax] = std::ranges::minmax(sim.getx());
+      auto [yMin, yMax] = std::ranges::minmax(sim.gety());
+      return pf::decimatePath(sim.getx(), sim.gety(), (xMax - xMin) / 700.0,
+                              (yMax - yMin) / 700.0);
+    };
+    std::vector<std::size_t> shortRun = segments(100000);
+    std::vector<std::size_t> longRun = segments(400000);
+    CHECK(shortRun.size() % 2 == 0);
+    CHECK(shortRun.size() < 20000);
+    CHECK(longRun.size() < shortRun.size() * 3 / 2);
+
+    std::vector<double> x = {1.0, 1.1, 5.0}, y = {1.0, 1.0, 1.0};
+    CHECK(pf::decimatePath(x, y, 0.0, 1.0).size() == 4);
+    CHECK(pf::decimatePath(x, y, 10.0, 10.0) ==
+          std::vector<std::size_t>{0, 2});
+  }
+
+  SUBCASE("min/max pyramid for zoomed views") {
+    // Passeggiata casuale deterministica: minimi e massimi ovunque
+    std::vector<double> t(300001), v(300001);
+    double value = 0.0;
+    unsigned state = 12345;
+    for (std::size_t i = 0; i < t.size(); ++i) {
+      state = state * 1103515245u + 12345u;
+      value += static_cast<double>(state >> 16 & 0xff) / 255.0 - 0.5;
+      t[i] = 0.01 * static_cast<double>(i);
+      v[i] = value;
+    }
+    pf::MinMaxPyramid pyramid(t, v, 64);
+    CHECK(pyramid.size() == t.size());
+    CHECK(pyramid.levelCount() > 10);
+
+    // Una sola colonna: primo, minimo, massimo e ultimo dell'intervallo
+    bool exact = true;
+    for (std::size_t first : {0ul, 1ul, 63ul, 64ul, 1000ul, 12345ul}) {
+      for (std::size_t count : {5ul, 64ul, 129ul, 5000ul, 250000ul}) {
+        std::size_t last = std::min(first + count, t.size()) - 1;
+        std::vector<std::size_t> kept = pyramid.visible(t[first], t[last], 1);
+        auto [low, high] =
+            std::ranges::minmax(std::span(v).subspan(first, last - first + 1));
+        exact = exact && kept.front() == first && kept.back() == last &&
+                std::ranges::is_sorted(kept);
+        double keptLow = 1e9, keptHigh = -1e9;
+        for (std::size_t i : kept) {
+          keptLow = std::min(keptLow, v[i]);
+          keptHigh = std::max(keptHigh, v[i]);
+        }
+        exact = exact && keptLow == low && keptHigh == high;
+      }
+    }
+    CHECK(exact);
+
+    // Vertici limitati dalle colonne, in ogni vista
+    std::vector<std::size_t> all = pyramid.visible(t.front(), t.back(), 700);
+    std::vector<std::size_t> zoomed = pyramid.visible(1000.0, 1500.0, 700);
+    CHECK(all.size() <= 4 * 700);
+    CHECK(zoomed.size() <= 4 * 700);
+    CHECK(t[zoomed.front()] >= 1000.0);
+    CHECK(t[zoomed.back()] <= 1500.0);
+    CHECK(std::ranges::is_sorted(zoomed));
+
+    // Pochi campioni visibili: tutti, nessuno tra due campioni
+    CHECK(pyramid.visible(10.0, 10.5, 700).size() == 51);
+    CHECK(pyramid.visible(10.001, 10.002, 700).empty());
+  }
+
+  SUBCASE("incremental min/max of a growing curve") {
+    pf::StreamingDecimator decimator(100);
+    double low = 1e9, high = -1e9;
+    std::size_t mostBuckets = 0;
+    for (std::size_t i = 0; i < 200000; ++i) {
+      double ti = 0.001 * static_cast<double>(i);
+      double vi = std::sin(ti) + (i == 123457 ? 5.0 : 0.0);
+      decimator.push(ti, vi);
+      low = std::min(low, vi);
+      high = std::max(high, vi);
+
+      mostBuckets = std::max(mostBuckets, decimator.bucketCount());
+    }
+    // Memoria limitata in ogni momento
+    CHECK(mostBuckets <= 100);
+    CHECK(decimator.bucketCount() > 25);
+    CHECK(decimator.min() == low);
+    CHECK(decimator.max() == high);
+    CHECK(decimator.tFirst() == 0.0);
+    CHECK(decimator.tLast() == doctest::Approx(199.999));
+
+    std::vector<pf::StreamingDecimator::Point> points = decimator.points();
+    CHECK(points.size() <= 400);
+    CHECK(points.front().t == 0.0);
+    CHECK(points.back().t == doctest::Approx(199.999));
+    CHECK(std::ranges::is_sorted(points, {}, &pf::StreamingDecimator::Point::t));
+
+    // Il picco isolato resta tra i vertici
+    CHECK(std::ranges::any_of(
+        points, [](const auto &p) { return p.v > 4.0; }));
+
+    // Pochi campioni: nessuna riduzione
+    pf::StreamingDecimator few(100);
+    for (int i = 0; i < 10; ++i)
+      few.push(i, i * i);
+    CHECK(few.points().size() == 10);
+  }
+}
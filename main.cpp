@@ -1,10 +1,44 @@
 #include <iostream>
 #include <limits> 
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
 
 #include "lotka_volterra.hpp"
 #include "graphic.hpp"
+#include "cli.hpp"
+
+// Modalita' non interattiva: i job descritti dalle opzioni (o dal file dei
+// job) vengono eseguiti senza domande e, salvo --plot, senza finestre
+int runBatch(const std::vector<std::string> &args) {
+  pf::CommandLine commandLine;
+  try {
+    commandLine = pf::parseCommandLine(args);
+  } catch (const std::invalid_argument &error) {
+    std::cerr << "Errore: " << error.what() << "\n\n" << pf::usage();
+    return 1;
+  }
+
+  if (commandLine.help) {
+    std::cout << pf::usage();
+    return 0;
+  }
+
+  std::size_t unstable = pf::runJobs(commandLine.jobs, commandLine.threads);
+  std::cout << commandLine.jobs.size() << " simulazioni completate, "
+            << unstable << " con H instabile\n";
+  // Codice diverso dagli errori delle opzioni, per gli script
+  return unstable > 0 ? 2 : 0;
+}
+
+int main(int argc, char *argv[]) {
+  // La sola opzione --live mantiene la modalita' interattiva, con le stesse
+  // domande, e mostra l'andamento durante la simulazione
+  bool live = argc == 2 && std::string(argv[1]) == "--live";
+  if (argc > 1 && !live)
+    return runBatch(std::vector<std::string>(argv + 1, argv + argc));
 
-int main() {
   // Richiesta e inserimento dei parametri A, B, C, D del modello
   std::cout << "Inserisci i parametri A, B, C e D separati da uno spazio\n";
   double newA, newB, newC, newD;
@@ -36,14 +70,16 @@ int main() {
     return 1;
   }
 
-  // Scelta del metodo di integrazione: Euler o Runge-Kutta 4
+  // Scelta del metodo di integrazione: Euler, Runge-Kutta 4 o adattivo
   std::cout << "Scegli il metodo di integrazione:\n";
   std::cout << "1 - Metodo di Eulero\n";
   std::cout << "2 - Runge-Kutta di ordine 4 (RK4)\n";
+  std::cout << "3 - Runge-Kutta adattivo Dormand-Prince 5(4)\n";
+  std::cout << "4 - Splitting simplettico in coordinate logaritmiche\n";
   int method_choice;
   std::cin >> method_choice;
 
-  if (std::cin.fail() || (method_choice != 1 && method_choice != 2)) {
+  if (std::cin.fail() || method_choice < 1 || method_choice > 4) {
     std::cerr << "Errore: scelta del metodo non valida!" << std::endl;
     return 1;
   }
@@ -53,6 +89,22 @@ int main() {
 
   if (method_choice == 2) {
     simulation.setUseRK4(true);
+  } else if (method_choice == 3) {
+    simulation.setMethod(pf::Method::DormandPrince);
+
+    std::cout << "Inserisci le tolleranze assoluta e relativa del metodo "
+                 "adattivo separate da uno spazio\n";
+    double absTol, relTol;
+    std::cin >> absTol >> relTol;
+
+    if (std::cin.fail() || absTol <= 0 || relTol <= 0) {
+      std::cerr << "Errore: le tolleranze devono essere numeri positivi!"
+                << std::endl;
+      return 1;
+    }
+    simulation.setTolerances(absTol, relTol);
+  } else if (method_choice == 4) {
+    simulation.setMethod(pf::Method::Symplectic);
   }
 
   // Scrive le coordinate del punto di equilibrio non banale su file
@@ -70,18 +122,45 @@ int main() {
     return 1;
   }
 
-  int steps = static_cast<int>(duration / 0.001);
+  int steps = 0;
+  try {
+    steps = pf::stepsFor(duration, 0.001);
+  } catch (const std::invalid_argument &error) {
+    std::cerr << "Errore: " << error.what() << std::endl;
+    return 1;
+  }
 
-  simulation.initializeVectors();
-  simulation.runSimulation(steps);
+  if (live) {
+    // La simulazione procede su un altro thread e pubblica i campioni per la
+    // finestra, che li disegna man mano; i dati vengono comunque salvati per
+    // i file e i grafici finali
+    std::cout << "Chiudere la finestra non interrompe la simulazione: i "
+                 "risultati arrivano al suo termine\n";
+    simulation.setKeepStreamedData(true);
+    pf::LiveSink sink;
+    std::thread worker([&] {
+      simulation.runSimulation(steps, sink);
+      sink.finish();
+    });
+    pf::plotLiveEvolution(sink);
+    worker.join();
+  } else {
+    simulation.initializeVectors();
+    simulation.runSimulation(steps);
+  }
   simulation.checkHStability(1e-4);
   simulation.writeResults();
   simulation.computeStatistics();
 
   std::cout << "Simulazione completata, risultati scritti in ValueList.txt, Statistics.txt e e_2Coordinates.txt\n";
 
-  pf::plotEquilibriumPointGraph(simulation.getx(), simulation.gety(), newA, newB, newC, newD);
-  pf::plotTimeEvolution(simulation.gett(), simulation.getx(), simulation.gety());
+  // I grafici vengono mostrati insieme; l'andamento temporale e' gia' stato
+  // mostrato durante la simulazione
+  pf::PlotSession plots;
+  plots.addEquilibriumPlot(simulation.getx(), simulation.gety(), newA, newB, newC, newD);
+  if (!live)
+    plots.addTimeEvolution(simulation.gett(), simulation.getx(), simulation.gety());
+  plots.run();
 
   return 0;
 }
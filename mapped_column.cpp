@@ -0,0 +1,156 @@
+#include "mapped_column.hpp"
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include <stdexcept>
+#include <utility>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace pf {
+
+MappedColumn::MappedColumn(const std::string &path, bool truncate)
+    : filePath(path) {
+  int flags = O_RDWR | O_CREAT | (truncate ? O_TRUNC : 0);
+  fd = ::open(path.c_str(), flags, 0644);
+  if (fd < 0)
+    throw std::runtime_error("Impossibile aprire " + path);
+
+  struct stat info {};
+  if (::fstat(fd, &info) != 0) {
+    ::close(fd);
+    throw std::runtime_error("Impossibile leggere " + path);
+  }
+
+  // Gli eventuali byte oltre l'ultimo double completo vengono ignorati
+  std::size_t existing = static_cast<std::size_t>(info.st_size) / sizeof(double);
+  try {
+    reallocate(existing);
+  } catch (...) {
+    ::close(fd);
+    throw;
+  }
+  count = existing;
+}
+
+MappedColumn::~MappedColumn() { release(); }
+
+MappedColumn::MappedColumn(const MappedColumn &other) { *this = other; }
+
+MappedColumn &MappedColumn::operator=(const MappedColumn &other) {
+  if (this != &other) {
+    count = 0;
+    reserve(other.count);
+    if (other.count > 0)
+      std::memcpy(values, other.values, other.count * sizeof(double));
+    count = other.count;
+  }
+  return *this;
+}
+
+MappedColumn::MappedColumn(MappedColumn &&other) noexcept
+    : values(std::exchange(other.values, nullptr)),
+      count(std::exchange(other.count, 0)),
+      capacity(std::exchange(other.capacity, 0)),
+      fd(std::exchange(other.fd, -1)), filePath(std::move(other.filePath)) {
+  other.filePath.clear();
+}
+
+MappedColumn &MappedColumn::operator=(MappedColumn &&other) noexcept {
+  if (this != &other) {
+    release();
+    values = std::exchange(other.values, nullptr);
+    count = std::exchange(other.count, 0);
+    capacity = std::exchange(other.capacity, 0);
+    fd = std::exchange(other.fd, -1);
+    filePath = std::move(other.filePath);
+    other.filePath.clear();
+  }
+  return *this;
+}
+
+void MappedColumn::append(std::span<const double> more) {
+  if (more.empty())
+    return;
+  if (count + more.size() > capacity)
+    reallocate(std::max(count + more.size(), 2 * capacity));
+  std::memcpy(values + count, more.data(), more.size() * sizeof(double));
+  count += more.size();
+}
+
+void MappedColumn::reserve(std::size_t n) {
+  if (n > capacity)
+    reallocate(n);
+}
+
+// I nuovi elementi valgono 0, come in std::vector
+void MappedColumn::resize(std::size_t n) {
+  if (n > capacity)
+    reallocate(std::max(n, 2 * capacity));
+  if (n > count)
+    std::fill(values + count, values + n, 0.0);
+  count = n;
+}
+
+// Con il file, la mappatura viene rifatta dopo averlo allungato: le pagine gia'
+// scritte restano nel file e non vengono copiate
+void MappedColumn::reallocate(std::size_t newCapacity) {
+  newCapacity = std::max(newCapacity, count);
+
+  if (fd < 0) {
+    if (newCapacity == 0) {
+      std::free(values);
+      values = nullptr;
+    } else {
+      void *grown = std::realloc(values, newCapacity * sizeof(double));
+      if (grown == nullptr)
+        throw std::bad_alloc();
+      values = static_cast<double *>(grown);
+    }
+    capacity = newCapacity;
+    return;
+  }
+
+  // In caso di errore la mappatura precedente resta valida
+  auto bytes = static_cast<off_t>(newCapacity * sizeof(double));
+  if (::ftruncate(fd, bytes) != 0)
+    throw std::runtime_error("Impossibile allungare " + filePath);
+
+  void *mapped = nullptr;
+  if (newCapacity > 0) {
+    mapped = ::mmap(nullptr, newCapacity * sizeof(double),
+                    PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (mapped == MAP_FAILED)
+      throw std::runtime_error("Impossibile mappare " + filePath);
+  }
+
+  if (values != nullptr)
+    ::munmap(values, capacity * sizeof(double));
+  values = static_cast<double *>(mapped);
+  capacity = newCapacity;
+}
+
+void MappedColumn::release() {
+  if (fd < 0) {
+    std::free(values);
+  } else {
+    if (values != nullptr)
+      ::munmap(values, capacity * sizeof(double));
+    // Il file resta con i soli dati validi
+    [[maybe_unused]] int result =
+        ::ftruncate(fd, static_cast<off_t>(count * sizeof(double)));
+    ::close(fd);
+  }
+  values = nullptr;
+  count = 0;
+  capacity = 0;
+  fd = -1;
+  filePath.clear();
+}
+
+} // namespace pf
@@ -0,0 +1,91 @@
+#ifndef MAPPED_COLUMN_HPP
+#define MAPPED_COLUMN_HPP
+
+#include <cstddef>
+#include <span>
+#include <string>
+
+namespace pf {
+
+// Colonna di double contigui che cresce come std::vector. Per default i valori
+// stanno nella memoria del processo; con un percorso vengono scritti in un
+// file mappato in memoria, cosi' il sistema operativo puo' spostare su disco
+// le pagine gia' scritte e una simulazione piu' grande della RAM non esaurisce
+// la memoria.
+// Il file contiene solo i double, nell'ordine dei byte della macchina: durante
+// la crescita e' piu' lungo dei dati (la coda e' azzerata) e viene portato alla
+// lunghezza esatta quando la colonna viene distrutta o sostituita
+class MappedColumn {
+private:
+  double *values = nullptr;
+  std::size_t count = 0;
+  std::size_t capacity = 0;
+  int fd = -1; // -1: memoria del processo
+  std::string filePath;
+
+  // Porta la capacita' a newCapacity elementi (mai sotto count)
+  void reallocate(std::size_t newCapacity);
+
+  // Libera la memoria o chiude il file, troncandolo alla lunghezza dei dati
+  void release();
+
+public:
+  MappedColumn() = default;
+
+  // Colonna mappata sul file path, creato se non esiste. Con truncate = false
+  // il contenuto del file viene conservato e la colonna parte da quei valori
+  // (per rileggere i dati di una simulazione senza conversioni); lancia
+  // std::runtime_error se il file non puo' essere aperto o mappato
+  explicit MappedColumn(const std::string &path, bool truncate = true);
+
+  ~MappedColumn();
+
+  // La copia risiede nella memoria del processo; l'assegnazione copia i
+  // valori nella memoria (o nel file) della colonna di destinazione
+  MappedColumn(const MappedColumn &other);
+  MappedColumn &operator=(const MappedColumn &other);
+
+  // Lo spostamento trasferisce anche il file; la sorgente resta vuota
+  MappedColumn(MappedColumn &&other) noexcept;
+  MappedColumn &operator=(MappedColumn &&other) noexcept;
+
+  void push_back(double value) {
+    if (count == capacity)
+      reallocate(capacity < 16 ? 16 : 2 * capacity);
+    values[count++] = value;
+  }
+
+  // Aggiunge in coda una sequenza di valori
+  void append(std::span<const double> more);
+
+  void reserve(std::size_t n);
+  void resize(std::size_t n);
+  void clear() { count = 0; }
+
+  std::size_t size() const { return count; }
+  bool empty() const { return count == 0; }
+
+  double *data() { return values; }
+  const double *data() const { return values; }
+  double &operator[](std::size_t i) { return values[i]; }
+  double operator[](std::size_t i) const { return values[i]; }
+  double front() const { return values[0]; }
+  double back() const { return values[count - 1]; }
+
+  double *begin() { return values; }
+  double *end() { return values + count; }
+  const double *begin() const { return values; }
+  const double *end() const { return values + count; }
+
+  std::span<const double> span() const { return {values, count}; }
+
+  // true se i valori stanno in un file mappato
+  bool isMapped() const { return fd >= 0; }
+
+  // Percorso del file (vuoto per la memoria del processo)
+  const std::string &path() const { return filePath; }
+};
+
+} // namespace pf
+
+#endif // MAPPED_COLUMN_HPP
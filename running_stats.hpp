@@ -0,0 +1,75 @@
+#ifndef RUNNING_STATS_HPP
+#define RUNNING_STATS_HPP
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+
+namespace pf {
+
+// Statistiche di una grandezza accumulate un valore alla volta, senza
+// conservare i campioni: minimo, massimo, media e varianza con l'algoritmo di
+// Welford, numericamente stabile anche per serie molto lunghe.
+// I valori infiniti o NaN (ad esempio H dopo un'estinzione) renderebbero NaN
+// media e varianza: vengono solo contati in nonFinite e tutte le altre
+// statistiche, count compreso, riguardano i soli valori finiti
+struct RunningStats {
+  double min = 0.0;
+  double max = 0.0;
+  double average = 0.0; // media corrente
+  double m2 = 0.0;      // somma dei quadrati degli scarti dalla media
+  std::size_t count = 0;
+  std::size_t nonFinite = 0;
+
+  void push(double value) {
+    if (!std::isfinite(value)) {
+      ++nonFinite;
+      return;
+    }
+    if (count == 0) {
+      min = value;
+      max = value;
+    } else {
+      min = std::min(min, value);
+      max = std::max(max, value);
+    }
+    ++count;
+    double delta = value - average;
+    average += delta / static_cast<double>(count);
+    m2 += delta * (value - average);
+  }
+
+  // Unisce le statistiche di un'altra serie (formula di Chan)
+  void merge(const RunningStats &other) {
+    nonFinite += other.nonFinite;
+    if (other.count == 0)
+      return;
+    if (count == 0) {
+      std::size_t skipped = nonFinite;
+      *this = other;
+      nonFinite = skipped;
+      return;
+    }
+    auto n = static_cast<double>(count);
+    auto m = static_cast<double>(other.count);
+    double delta = other.average - average;
+    min = std::min(min, other.min);
+    max = std::max(max, other.max);
+    average += delta * m / (n + m);
+    m2 += other.m2 + delta * delta * n * m / (n + m);
+    count += other.count;
+  }
+
+  void reset() { *this = RunningStats{}; }
+
+  double mean() const { return average; }
+
+  // Varianza della serie (divisa per il numero di campioni)
+  double variance() const {
+    return count == 0 ? 0.0 : m2 / static_cast<double>(count);
+  }
+};
+
+} // namespace pf
+
+#endif // RUNNING_STATS_HPP
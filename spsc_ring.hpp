@@ -0,0 +1,93 @@
+#ifndef SPSC_RING_HPP
+#define SPSC_RING_HPP
+
+#include <atomic>
+#include <cstddef>
+#include <vector>
+
+namespace pf {
+
+// Coda circolare senza lock per un solo produttore e un solo consumatore.
+// Gli elementi restano negli slot e vengono riutilizzati: il produttore
+// scrive direttamente nello slot restituito da acquire e lo rende visibile con
+// publish, il consumatore lo legge con front e lo libera con pop. Le attese
+// (coda piena o vuota) usano std::atomic::wait, senza mutex ne' cicli attivi
+template <class T> class SpscRing {
+private:
+  std::vector<T> slots;
+
+  // Indici sempre crescenti: head e' il prossimo elemento da leggere, tail il
+  // prossimo da scrivere. Sono su linee di cache diverse per non contendersele
+  alignas(64) std::atomic<std::size_t> head{0};
+  alignas(64) std::atomic<std::size_t> tail{0};
+
+public:
+  explicit SpscRing(std::size_t capacity) : slots(capacity > 0 ? capacity : 1) {}
+
+  std::size_t capacity() const { return slots.size(); }
+
+  // Produttore: slot libero, oppure nullptr se la coda e' piena
+  T *tryAcquire() {
+    std::size_t t = tail.load(std::memory_order_relaxed);
+    if (t - head.load(std::memory_order_acquire) == slots.size())
+      return nullptr;
+    return &slots[t % slots.size()];
+  }
+
+  // Produttore: slot libero, attendendo che il consumatore ne liberi uno
+  T &acquire() {
+    std::size_t t = tail.load(std::memory_order_relaxed);
+    std::size_t h = head.load(std::memory_order_acquire);
+    while (t - h == slots.size()) {
+      head.wait(h, std::memory_order_acquire);
+      h = head.load(std::memory_order_acquire);
+    }
+    return slots[t % slots.size()];
+  }
+
+  // Produttore: rende visibile al consumatore lo slot ottenuto da acquire
+  void publish() {
+    tail.fetch_add(1, std::memory_order_release);
+    tail.notify_one();
+  }
+
+  // Consumatore: prossimo elemento, oppure nullptr se la coda e' vuota
+  T *tryFront() {
+    std::size_t h = head.load(std::memory_order_relaxed);
+    if (tail.load(std::memory_order_acquire) == h)
+      return nullptr;
+    return &slots[h % slots.size()];
+  }
+
+  // Consumatore: prossimo elemento, attendendo che il produttore ne pubblichi
+  // uno
+  T &front() {
+    std::size_t h = head.load(std::memory_order_relaxed);
+    std::size_t t = tail.load(std::memory_order_acquire);
+    while (t == h) {
+      tail.wait(t, std::memory_order_acquire);
+      t = tail.load(std::memory_order_acquire);
+    }
+    return slots[h % slots.size()];
+  }
+
+  // Consumatore: libera l'elemento letto con front
+  void pop() {
+    head.fetch_add(1, std::memory_order_release);
+    head.notify_one();
+  }
+
+  // Produttore: attende che il consumatore abbia letto tutti gli elementi
+  void waitEmpty() {
+    std::size_t t = tail.load(std::memory_order_relaxed);
+    std::size_t h = head.load(std::memory_order_acquire);
+    while (h != t) {
+      head.wait(h, std::memory_order_acquire);
+      h = head.load(std::memory_order_acquire);
+    }
+  }
+};
+
+} // namespace pf
+
+#endif // SPSC_RING_HPP
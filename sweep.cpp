@@ -0,0 +1,171 @@
+#include "sweep.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <fstream>
+#include <iomanip>
+#include <limits>
+#include <thread>
+
+namespace pf {
+
+namespace {
+
+// Sink che calcola il riassunto di una simulazione senza conservarne i campioni
+class SummarySink : public TrajectorySink {
+private:
+  RunSummary &summary;
+  bool first = true;
+  double H0 = 0.0;
+
+public:
+  explicit SummarySink(RunSummary &newSummary) : summary(newSummary) {}
+
+  void consume(const TrajectoryChunk &chunk) override {
+    for (std::size_t m = 0; m < chunk.size(); ++m) {
+      summary.x.push(chunk.x[m]);
+      summary.y.push(chunk.y[m]);
+      summary.H.push(chunk.H[m]);
+
+      if (first) {
+        H0 = chunk.H[m];
+        first = false;
+      }
+      double deviation = std::fabs(chunk.H[m] - H0) / std::fabs(H0);
+      summary.maxHDeviation = std::max(summary.maxHDeviation, deviation);
+
+      bool extinct = chunk.x[m] <= 0.0 || chunk.y[m] <= 0.0;
+      if (extinct && std::isinf(summary.extinctionTime))
+        summary.extinctionTime = chunk.t[m];
+    }
+  }
+};
+
+// Nome del metodo per il file dei riassunti
+const char *methodName(Method method) {
+  switch (method) {
+  case Method::Euler:
+    return "Euler";
+  case Method::RK4:
+    return "RK4";
+  case Method::DormandPrince:
+    return "DormandPrince";
+  case Method::Symplectic:
+    return "Symplectic";
+  }
+  return "?";
+}
+
+} // namespace
+
+std::size_t SweepSpec::numRuns() const {
+  return A.size() * B.size() * C.size() * D.size() * x_0.size() *
+         y_0.size() * methods.size();
+}
+
+std::vector<double> linspace(double first, double last, std::size_t count) {
+  std::vector<double> values;
+  if (count == 1)
+    values.push_back(first);
+  for (std::size_t i = 0; count > 1 && i < count; ++i) {
+    values.push_back(first + (last - first) * static_cast<double>(i) /
+                                 static_cast<double>(count - 1));
+  }
+  return values;
+}
+
+std::vector<RunSummary> runSweep(const SweepSpec &spec, unsigned threads) {
+  std::vector<RunSummary> summaries(spec.numRuns());
+  if (summaries.empty())
+    return summaries;
+
+  // Esegue la simulazione di indice index, ricavando i parametri dalle cifre
+  // dell'indice in base alle dimensioni delle liste
+  auto runOne = [&spec, &summaries](std::size_t index) {
+    std::size_t rest = index;
+    auto pick = [&rest](const auto &values) {
+      auto value = values[rest % values.size()];
+      rest /= values.size();
+      return value;
+    };
+    Method method = pick(spec.methods);
+    double y_0 = pick(spec.y_0);
+    double x_0 = pick(spec.x_0);
+    double D = pick(spec.D);
+    double C = pick(spec.C);
+    double B = pick(spec.B);
+    double A = pick(spec.A);
+
+    Simulation sim(A, B, C, D, x_0, y_0, spec.dt);
+    sim.setMethod(method);
+
+    // Il riassunto viene aggiornato a ogni campione: resta locale al thread e
+    // viene copiato nel vettore condiviso solo alla fine, perche' riassunti
+    // vicini nel vettore condividono le linee di cache
+    RunSummary summary{};
+    summary.A = A;
+    summary.B = B;
+    summary.C = C;
+    summary.D = D;
+    summary.x_0 = x_0;
+    summary.y_0 = y_0;
+    summary.method = method;
+    summary.e2_x = sim.e2_x();
+    summary.e2_y = sim.e2_y();
+    summary.maxHDeviation = 0.0;
+    summary.extinctionTime = std::numeric_limits<double>::infinity();
+
+    SummarySink sink(summary);
+    sim.runSimulation(spec.steps, sink);
+    summaries[index] = summary;
+  };
+
+  if (threads == 0)
+    threads = std::max(1u, std::thread::hardware_concurrency());
+  threads = static_cast<unsigned>(
+      std::min<std::size_t>(threads, summaries.size()));
+
+  // Le simulazioni sono indipendenti: ogni thread prende la prossima non
+  // ancora assegnata da un contatore condiviso, cosi' i thread che finiscono
+  // prima continuano a lavorare finche' ne rimangono
+  std::atomic<std::size_t> next{0};
+  auto worker = [&] {
+    for (std::size_t i = next.fetch_add(1); i < summaries.size();
+         i = next.fetch_add(1))
+      runOne(i);
+  };
+
+  std::vector<std::thread> pool;
+  for (unsigned i = 1; i < threads; ++i)
+    pool.emplace_back(worker);
+  worker();
+  for (auto &thread : pool)
+    thread.join();
+
+  return summaries;
+}
+
+void writeSweepSummaries(const std::vector<RunSummary> &summaries,
+                         const std::string &path) {
+  std::ofstream out(path);
+  out << std::fixed << std::setprecision(6);
+
+  out << "A\tB\tC\tD\tx_0\ty_0\tMETODO\te2_x\te2_y\tMIN(x)\tMAX(x)\tMEDIA(x)"
+         "\tMIN(y)\tMAX(y)\tMEDIA(y)\tMIN(H)\tMAX(H)\tMEDIA(H)\tDEV(H)"
+         "\tESTINZIONE\n\n";
+
+  for (const RunSummary &s : summaries) {
+    out << s.A << "\t" << s.B << "\t" << s.C << "\t" << s.D << "\t" << s.x_0
+        << "\t" << s.y_0 << "\t" << methodName(s.method) << "\t" << s.e2_x
+        << "\t" << s.e2_y << "\t" << s.x.min << "\t" << s.x.max << "\t"
+        << s.x.mean() << "\t" << s.y.min << "\t" << s.y.max << "\t"
+        << s.y.mean() << "\t" << s.H.min << "\t" << s.H.max << "\t"
+        << s.H.mean() << "\t" << s.maxHDeviation << "\t" << s.extinctionTime
+        << "\n";
+  }
+
+  out.close();
+}
+
+} // namespace pf
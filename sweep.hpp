@@ -0,0 +1,61 @@
+#ifndef SWEEP_HPP
+#define SWEEP_HPP
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+#include "lotka_volterra.hpp"
+#include "trajectory_sink.hpp"
+
+namespace pf {
+
+// Esplorazione dello spazio dei parametri: ogni campo e' una lista di valori e
+// vengono simulate tutte le combinazioni
+struct SweepSpec {
+  std::vector<double> A, B, C, D;
+  std::vector<double> x_0, y_0;
+  std::vector<Method> methods{Method::RK4};
+
+  // Passo temporale e numero di passi di ciascuna simulazione
+  double dt = 0.001;
+  int steps = 10000;
+
+  // Numero totale di simulazioni (prodotto delle dimensioni delle liste)
+  std::size_t numRuns() const;
+};
+
+// Restituisce count valori equispaziati nell'intervallo [first, last]
+std::vector<double> linspace(double first, double last, std::size_t count);
+
+// Riassunto di una singola simulazione dell'esplorazione
+struct RunSummary {
+  // Parametri e metodo della simulazione
+  double A, B, C, D, x_0, y_0;
+  Method method;
+
+  // Coordinate del punto di equilibrio e_2
+  double e2_x, e2_y;
+
+  // Minimo, massimo e media di x, y e H, come in computeStatistics
+  StatisticsSink::Column x, y, H;
+
+  // Massima deviazione relativa di H, come in checkHStability
+  double maxHDeviation;
+
+  // Istante della prima estinzione (infinito se nessuna specie si estingue)
+  double extinctionTime;
+};
+
+// Esegue tutte le simulazioni dell'esplorazione su threads thread (0 = tutti i
+// core disponibili); i riassunti sono nell'ordine delle combinazioni, con A
+// che varia piu' lentamente e il metodo piu' velocemente
+std::vector<RunSummary> runSweep(const SweepSpec &spec, unsigned threads = 0);
+
+// Scrive i riassunti su file, una riga per simulazione
+void writeSweepSummaries(const std::vector<RunSummary> &summaries,
+                         const std::string &path = "Sweep.txt");
+
+} // namespace pf
+
+#endif // SWEEP_HPP
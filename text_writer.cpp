@@ -0,0 +1,88 @@
+#include "text_writer.hpp"
+
+#include <algorithm>
+#include <charconv>
+
+namespace pf {
+
+namespace {
+
+// Spazio massimo occupato da una riga: in formato fisso un double puo' avere
+// fino a 309 cifre intere, piu' segno, punto e 6 decimali
+constexpr std::size_t maxNumberLength = 320;
+constexpr std::size_t maxRowLength = 4 * (maxNumberLength + 1);
+
+} // namespace
+
+TextWriter::TextWriter(const std::string &path, TextFormat newFormat,
+                       std::size_t bufferSize)
+    : out(path, std::ios::binary),
+      buffer(std::max(bufferSize, 2 * maxRowLength)), format(newFormat) {}
+
+TextWriter::~TextWriter() { flush(); }
+
+// Svuota il buffer se non c'e' spazio per un'altra riga
+void TextWriter::reserveRow() {
+  if (buffer.size() - used < maxRowLength)
+    flush();
+}
+
+void TextWriter::put(double value) {
+  char *first = buffer.data() + used;
+  char *last = buffer.data() + buffer.size();
+  std::to_chars_result result =
+      format == TextFormat::Fixed
+          ? std::to_chars(first, last, value, std::chars_format::fixed, 6)
+          : std::to_chars(first, last, value);
+  used = static_cast<std::size_t>(result.ptr - buffer.data());
+}
+
+void TextWriter::write(std::string_view text) {
+  if (buffer.size() - used < text.size()) {
+    flush();
+    if (buffer.size() < text.size()) {
+      out.write(text.data(), static_cast<std::streamsize>(text.size()));
+      return;
+    }
+  }
+  std::copy(text.begin(), text.end(), buffer.begin() +
+                                          static_cast<std::ptrdiff_t>(used));
+  used += text.size();
+}
+
+void TextWriter::writeHeader(bool withH) {
+  write(withH ? "TIME\t\tPREY(x)\t\tPREDATOR(y)\t\tH\n\n"
+              : "TIME\t\tPREY(x)\t\tPREDATOR(y)\n\n");
+}
+
+void TextWriter::writeRow(double t, double x, double y) {
+  reserveRow();
+  put(t);
+  put('\t');
+  put(x);
+  put('\t');
+  put(y);
+  put('\n');
+}
+
+void TextWriter::writeRow(double t, double x, double y, double H) {
+  reserveRow();
+  put(t);
+  put('\t');
+  put(x);
+  put('\t');
+  put(y);
+  put('\t');
+  put(H);
+  put('\n');
+}
+
+void TextWriter::flush() {
+  if (used > 0) {
+    out.write(buffer.data(), static_cast<std::streamsize>(used));
+    used = 0;
+  }
+  out.flush();
+}
+
+} // namespace pf
@@ -0,0 +1,57 @@
+#ifndef TEXT_WRITER_HPP
+#define TEXT_WRITER_HPP
+
+#include <cstddef>
+#include <fstream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace pf {
+
+// Formato dei numeri nei file di testo
+enum class TextFormat {
+  Fixed,   // 6 cifre decimali, come std::fixed << std::setprecision(6)
+  Shortest // rappresentazione piu' corta che rilegge esattamente lo stesso double
+};
+
+// Scrittura veloce di righe di numeri separati da tabulazioni. I numeri sono
+// formattati con std::to_chars (senza locale ne' stato dello stream) in un
+// buffer manuale, che viene passato al file con una sola write quando e' pieno
+class TextWriter {
+private:
+  std::ofstream out;
+  std::vector<char> buffer;
+  std::size_t used = 0;
+  TextFormat format;
+
+  void reserveRow();
+  void put(double value);
+  void put(char c) { buffer[used++] = c; }
+
+public:
+  explicit TextWriter(const std::string &path,
+                      TextFormat newFormat = TextFormat::Fixed,
+                      std::size_t bufferSize = std::size_t{1} << 20);
+  ~TextWriter();
+
+  TextWriter(const TextWriter &) = delete;
+  TextWriter &operator=(const TextWriter &) = delete;
+
+  // Testo senza formattazione, ad esempio l'intestazione delle colonne
+  void write(std::string_view text);
+
+  // Intestazione delle colonne scritte da writeRow, con o senza H
+  void writeHeader(bool withH);
+
+  // Una riga t, x, y (e H) terminata da '\n'
+  void writeRow(double t, double x, double y);
+  void writeRow(double t, double x, double y, double H);
+
+  // Passa al file il contenuto del buffer
+  void flush();
+};
+
+} // namespace pf
+
+#endif // TEXT_WRITER_HPP
@@ -0,0 +1,167 @@
+#include "trajectory_io.hpp"
+
+#include <cstring>
+#include <fstream>
+#include <limits>
+#include <stdexcept>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace pf {
+
+namespace {
+
+constexpr char binaryMagic[8] = "LVTRAJ1";
+constexpr std::uint32_t binaryVersion = 1;
+
+// Controlla magic, versione e dimensione attesa del file
+void validate(const BinaryTrajectoryHeader &header, std::size_t fileSize,
+              const std::string &path) {
+  if (std::memcmp(header.magic, binaryMagic, sizeof binaryMagic) != 0 ||
+      header.version != binaryVersion) {
+    throw std::runtime_error("File binario non valido: " + path);
+  }
+  // Il confronto evita il prodotto columns * count, che con un count
+  // arbitrario potrebbe superare il massimo di size_t
+  std::size_t columns = header.hasH ? 4 : 3;
+  if (fileSize < sizeof header ||
+      header.count > (fileSize - sizeof header) / (columns * sizeof(double))) {
+    throw std::runtime_error("File binario troncato: " + path);
+  }
+}
+
+// Scrive una colonna di double cosi' come sono in memoria
+void writeColumn(std::ofstream &out, std::span<const double> column) {
+  out.write(reinterpret_cast<const char *>(column.data()),
+            static_cast<std::streamsize>(column.size_bytes()));
+}
+
+// Legge count double in una colonna
+void readColumn(std::ifstream &in, std::vector<double> &column,
+                std::size_t count) {
+  column.resize(count);
+  in.read(reinterpret_cast<char *>(column.data()),
+          static_cast<std::streamsize>(count * sizeof(double)));
+}
+
+} // namespace
+
+BinaryTrajectoryHeader makeBinaryHeader() {
+  BinaryTrajectoryHeader header{};
+  std::memcpy(header.magic, binaryMagic, sizeof binaryMagic);
+  header.version = binaryVersion;
+  header.stride = 1;
+  return header;
+}
+
+std::uint32_t binaryStride(std::size_t stride) {
+  if (stride > std::numeric_limits<std::uint32_t>::max())
+    throw std::invalid_argument("Passo di registrazione troppo grande per il "
+                                "formato binario");
+  return static_cast<std::uint32_t>(stride);
+}
+
+void writeBinaryTrajectory(const std::string &path,
+                           BinaryTrajectoryHeader header,
+                           std::span<const double> t, std::span<const double> x,
+                           std::span<const double> y,
+                           std::span<const double> H) {
+  header.count = t.size();
+  header.hasH = H.empty() ? 0 : 1;
+
+  std::ofstream out(path, std::ios::binary);
+  out.write(reinterpret_cast<const char *>(&header), sizeof header);
+  writeColumn(out, t);
+  writeColumn(out, x);
+  writeColumn(out, y);
+  if (header.hasH)
+    writeColumn(out, H);
+  out.close();
+  if (!out)
+    throw std::runtime_error("Impossibile scrivere " + path);
+}
+
+BinaryTrajectory readBinaryTrajectory(const std::string &path) {
+  std::ifstream in(path, std::ios::binary | std::ios::ate);
+  if (!in)
+    throw std::runtime_error("Impossibile aprire " + path);
+  auto fileSize = static_cast<std::size_t>(in.tellg());
+  in.seekg(0);
+
+  BinaryTrajectory result;
+  if (fileSize < sizeof result.header)
+    throw std::runtime_error("File binario troncato: " + path);
+  in.read(reinterpret_cast<char *>(&result.header), sizeof result.header);
+  validate(result.header, fileSize, path);
+
+  auto count = static_cast<std::size_t>(result.header.count);
+  readColumn(in, result.t, count);
+  readColumn(in, result.x, count);
+  readColumn(in, result.y, count);
+  if (result.header.hasH)
+    readColumn(in, result.H, count);
+  return result;
+}
+
+MappedTrajectory::MappedTrajectory(const std::string &path) {
+  int fd = ::open(path.c_str(), O_RDONLY);
+  if (fd < 0)
+    throw std::runtime_error("Impossibile aprire " + path);
+
+  struct stat info {};
+  if (::fstat(fd, &info) != 0 ||
+      static_cast<std::size_t>(info.st_size) < sizeof(BinaryTrajectoryHeader)) {
+    ::close(fd);
+    throw std::runtime_error("File binario troncato: " + path);
+  }
+
+  length = static_cast<std::size_t>(info.st_size);
+  base = ::mmap(nullptr, length, PROT_READ, MAP_SHARED, fd, 0);
+  ::close(fd);
+  if (base == MAP_FAILED) {
+    base = nullptr;
+    throw std::runtime_error("Impossibile mappare " + path);
+  }
+
+  try {
+    validate(header(), length, path);
+  } catch (...) {
+    ::munmap(base, length);
+    throw;
+  }
+}
+
+MappedTrajectory::~MappedTrajectory() {
+  if (base != nullptr)
+    ::munmap(base, length);
+}
+
+const BinaryTrajectoryHeader &MappedTrajectory::header() const {
+  return *static_cast<const BinaryTrajectoryHeader *>(base);
+}
+
+// Le colonne seguono l'intestazione una dopo l'altra
+std::span<const double> MappedTrajectory::t() const {
+  auto first = reinterpret_cast<const double *>(
+      static_cast<const char *>(base) + sizeof(BinaryTrajectoryHeader));
+  return {first, static_cast<std::size_t>(header().count)};
+}
+
+std::span<const double> MappedTrajectory::x() const {
+  return {t().data() + t().size(), t().size()};
+}
+
+std::span<const double> MappedTrajectory::y() const {
+  return {x().data() + x().size(), x().size()};
+}
+
+std::span<const double> MappedTrajectory::H() const {
+  if (!header().hasH)
+    return {};
+  return {y().data() + y().size(), y().size()};
+}
+
+} // namespace pf
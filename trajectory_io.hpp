@@ -0,0 +1,82 @@
+#ifndef TRAJECTORY_IO_HPP
+#define TRAJECTORY_IO_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <string>
+#include <vector>
+
+namespace pf {
+
+// Intestazione del formato binario a colonne (ValueList.bin): 128 byte seguiti
+// dalle colonne t, x, y e (se presente) H, ciascuna di count double contigui
+// nell'ordine dei byte della macchina. Le colonne sono allineate a 8 byte, cosi'
+// il file puo' essere mappato in memoria e letto senza conversioni
+struct BinaryTrajectoryHeader {
+  char magic[8];          // "LVTRAJ1"
+  std::uint32_t version;  // versione del formato
+  std::uint32_t method;   // valore di pf::Method
+  double A, B, C, D;      // coefficienti del sistema
+  double x_0, y_0;        // condizioni iniziali
+  double dt;              // passo di integrazione
+  std::uint64_t count;    // numero di campioni per colonna
+  std::uint32_t hasH;     // 1 se la colonna H e' presente
+  std::uint32_t stride;   // passo di registrazione
+  char reserved[40];      // spazio per estensioni future, azzerato
+};
+
+static_assert(sizeof(BinaryTrajectoryHeader) == 128,
+              "l'intestazione binaria deve occupare 128 byte");
+
+// Traiettoria letta da un file binario
+struct BinaryTrajectory {
+  BinaryTrajectoryHeader header;
+  std::vector<double> t, x, y, H;
+};
+
+// Crea un'intestazione con magic e versione correnti
+BinaryTrajectoryHeader makeBinaryHeader();
+
+// Converte il passo di registrazione nel campo stride dell'intestazione;
+// lancia std::invalid_argument se non sta in 32 bit
+std::uint32_t binaryStride(std::size_t stride);
+
+// Scrive una traiettoria nel formato binario a colonne; H puo' essere vuoto.
+// Lancia std::runtime_error se la scrittura fallisce
+void writeBinaryTrajectory(const std::string &path,
+                           BinaryTrajectoryHeader header,
+                           std::span<const double> t, std::span<const double> x,
+                           std::span<const double> y,
+                           std::span<const double> H);
+
+// Legge un file binario copiando le colonne in memoria; lancia
+// std::runtime_error se il file non e' valido
+BinaryTrajectory readBinaryTrajectory(const std::string &path);
+
+// Vista in sola lettura su un file binario mappato in memoria: le colonne non
+// vengono copiate ma lette direttamente dalle pagine del file
+class MappedTrajectory {
+private:
+  void *base = nullptr;
+  std::size_t length = 0;
+
+public:
+  // Mappa il file; lancia std::runtime_error se il file non e' valido
+  explicit MappedTrajectory(const std::string &path);
+  ~MappedTrajectory();
+
+  MappedTrajectory(const MappedTrajectory &) = delete;
+  MappedTrajectory &operator=(const MappedTrajectory &) = delete;
+
+  const BinaryTrajectoryHeader &header() const;
+
+  std::span<const double> t() const;
+  std::span<const double> x() const;
+  std::span<const double> y() const;
+  std::span<const double> H() const; // vuota se H non e' presente
+};
+
+} // namespace pf
+
+#endif // TRAJECTORY_IO_HPP
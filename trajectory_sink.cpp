@@ -0,0 +1,182 @@
+#include "trajectory_sink.hpp"
+
+#include <algorithm>
+#include <iomanip>
+
+namespace pf {
+
+FileSink::FileSink(const std::string &path, TextFormat format)
+    : out(path, format) {}
+
+// L'intestazione segue le colonne del primo blocco, che dicono se H e' presente
+void FileSink::consume(const TrajectoryChunk &chunk) {
+  if (!headerWritten) {
+    out.writeHeader(!chunk.H.empty());
+    headerWritten = true;
+  }
+  if (chunk.H.empty()) {
+    for (std::size_t m = 0; m < chunk.size(); ++m)
+      out.writeRow(chunk.t[m], chunk.x[m], chunk.y[m]);
+  } else {
+    for (std::size_t m = 0; m < chunk.size(); ++m)
+      out.writeRow(chunk.t[m], chunk.x[m], chunk.y[m], chunk.H[m]);
+  }
+}
+
+void FileSink::flush() { out.flush(); }
+
+void StatisticsSink::consume(const TrajectoryChunk &chunk) {
+  for (std::size_t m = 0; m < chunk.size(); ++m) {
+    sx.push(chunk.x[m]);
+    sy.push(chunk.y[m]);
+  }
+  for (double Hval : chunk.H)
+    sH.push(Hval);
+}
+
+const StatisticsSink::Column &StatisticsSink::getx() const { return sx; }
+const StatisticsSink::Column &StatisticsSink::gety() const { return sy; }
+const StatisticsSink::Column &StatisticsSink::getH() const { return sH; }
+
+void StatisticsSink::writeStatistics(const std::string &path) const {
+  pf::writeStatistics(path, sx, sy, sH);
+}
+
+DecimatingSink::DecimatingSink(std::size_t newStride)
+    : stride(std::max<std::size_t>(newStride, 1)) {}
+
+// Conserva solo i campioni il cui indice globale e' multiplo di stride
+void DecimatingSink::consume(const TrajectoryChunk &chunk) {
+  for (std::size_t m = 0; m < chunk.size(); ++m, ++seen) {
+    if (seen % stride == 0) {
+      t.push_back(chunk.t[m]);
+      x.push_back(chunk.x[m]);
+      y.push_back(chunk.y[m]);
+    }
+  }
+}
+
+const std::vector<double> &DecimatingSink::gett() const { return t; }
+const std::vector<double> &DecimatingSink::getx() const { return x; }
+const std::vector<double> &DecimatingSink::gety() const { return y; }
+
+// Gli slot sono almeno due, uno in scrittura e uno in riempimento
+AsyncSink::AsyncSink(TrajectorySink &target, std::size_t slots)
+    : inner(target), ring(std::max<std::size_t>(slots, 2)),
+      worker(&AsyncSink::drain, this) {}
+
+// Un blocco vuoto segnala al thread di terminare
+AsyncSink::~AsyncSink() {
+  ring.waitEmpty();
+  ring.acquire().clear();
+  ring.publish();
+  worker.join();
+}
+
+// Ciclo del thread di scrittura
+void AsyncSink::drain() {
+  while (true) {
+    TrajectoryChunk &chunk = ring.front();
+    if (chunk.empty()) {
+      ring.pop();
+      return;
+    }
+    inner.consume(chunk);
+    ring.pop();
+  }
+}
+
+// L'assegnazione riusa la memoria gia' allocata nello slot
+void AsyncSink::consume(const TrajectoryChunk &chunk) {
+  if (chunk.empty())
+    return;
+  TrajectoryChunk &slot = ring.acquire();
+  slot.t = chunk.t;
+  slot.x = chunk.x;
+  slot.y = chunk.y;
+  slot.H = chunk.H;
+  ring.publish();
+}
+
+void AsyncSink::flush() {
+  ring.waitEmpty();
+  inner.flush();
+}
+
+LiveSink::LiveSink(std::size_t slots) : ring(std::max<std::size_t>(slots, 2)) {}
+
+void LiveSink::consume(const TrajectoryChunk &chunk) {
+  if (chunk.empty() || closed.load(std::memory_order_acquire))
+    return;
+  TrajectoryChunk &slot = ring.acquire();
+  slot.t = chunk.t;
+  slot.x = chunk.x;
+  slot.y = chunk.y;
+  slot.H = chunk.H;
+  ring.publish();
+}
+
+// Un blocco vuoto segnala la fine
+void LiveSink::finish() {
+  if (closed.load(std::memory_order_acquire))
+    return;
+  ring.acquire().clear();
+  ring.publish();
+}
+
+// Dopo aver svuotato la coda il produttore trova sempre uno slot libero: un
+// blocco gia' in scrittura puo' ancora arrivare, i successivi vengono scartati
+void LiveSink::close() {
+  closed.store(true, std::memory_order_release);
+  while (ring.tryFront() != nullptr)
+    ring.pop();
+  ended = true;
+}
+
+// Scrive l'esito nel formato di H_Stability.txt
+bool writeHStability(const std::string &path, double H0, double maxDeviation,
+                     double tolerance) {
+  bool stable = maxDeviation <= tolerance;
+  std::ofstream out(path);
+  out << std::fixed << std::setprecision(6);
+  out << "H iniziale: " << H0 << "\n";
+  out << "Massima deviazione relativa: " << maxDeviation << "\n";
+  out << "Tolleranza: " << tolerance << "\n";
+  out << "Stabile: " << (stable ? "SI" : "NO") << "\n";
+  return stable;
+}
+
+// Scrive le statistiche nel formato di Statistics.txt
+void writeStatistics(const std::string &path, const RunningStats &x,
+                     const RunningStats &y, const RunningStats &H) {
+  std::ofstream out(path);
+  out << std::fixed << std::setprecision(6);
+
+  out << "STATISTICHE:\n\n";
+  out << "Prede (x):\n"
+      << "  Min: " << x.min << "\n"
+      << "  Max: " << x.max << "\n"
+      << "  Media: " << x.mean() << "\n"
+      << "  Varianza: " << x.variance() << "\n\n";
+
+  out << "Predatori (y):\n"
+      << "  Min: " << y.min << "\n"
+      << "  Max: " << y.max << "\n"
+      << "  Media: " << y.mean() << "\n"
+      << "  Varianza: " << y.variance() << "\n";
+
+  if (H.count > 0 || H.nonFinite > 0) {
+    out << "\nIntegrale del moto (H):\n"
+        << "  Min: " << H.min << "\n"
+        << "  Max: " << H.max << "\n"
+        << "  Media: " << H.mean() << "\n"
+        << "  Varianza: " << H.variance() << "\n";
+    // Ad esempio dopo un'estinzione, dove H e' infinito
+    if (H.nonFinite > 0)
+      out << "  Valori non finiti (esclusi): " << H.nonFinite << "\n";
+  }
+
+  out.close();
+}
+
+} // namespace pf
@@ -0,0 +1,207 @@
+#ifndef TRAJECTORY_SINK_HPP
+#define TRAJECTORY_SINK_HPP
+
+#include <atomic>
+#include <cstddef>
+#include <fstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "running_stats.hpp"
+#include "spsc_ring.hpp"
+#include "text_writer.hpp"
+
+namespace pf {
+
+// Blocco di campioni consecutivi (t, x, y, H) della traiettoria. Se il calcolo
+// di H e' disattivato la colonna H resta vuota
+struct TrajectoryChunk {
+  std::vector<double> t;
+  std::vector<double> x;
+  std::vector<double> y;
+  std::vector<double> H;
+
+  std::size_t size() const { return t.size(); }
+  bool empty() const { return t.empty(); }
+
+  // Aggiunge un campione senza H
+  void push(double ti, double xi, double yi) {
+    t.push_back(ti);
+    x.push_back(xi);
+    y.push_back(yi);
+  }
+
+  // Aggiunge un campione completo
+  void push(double ti, double xi, double yi, double Hi) {
+    t.push_back(ti);
+    x.push_back(xi);
+    y.push_back(yi);
+    H.push_back(Hi);
+  }
+
+  // Svuota il blocco mantenendo la memoria gia' allocata
+  void clear() {
+    t.clear();
+    x.clear();
+    y.clear();
+    H.clear();
+  }
+
+  void reserve(std::size_t n) {
+    t.reserve(n);
+    x.reserve(n);
+    y.reserve(n);
+    H.reserve(n);
+  }
+};
+
+// Destinazione dei blocchi prodotti da Simulation::runSimulation in modalita'
+// streaming. Il blocco passato a consume viene riutilizzato subito dopo, quindi
+// va elaborato o copiato prima di restituire il controllo
+class TrajectorySink {
+public:
+  virtual ~TrajectorySink() = default;
+
+  // Elabora un blocco di campioni
+  virtual void consume(const TrajectoryChunk &chunk) = 0;
+
+  // Chiamata alla fine di ogni esecuzione in streaming
+  virtual void flush() {}
+};
+
+// Scrive i campioni su file di testo, nello stesso formato di writeResults
+class FileSink : public TrajectorySink {
+private:
+  TextWriter out;
+  bool headerWritten = false;
+
+public:
+  explicit FileSink(const std::string &path = "ValueList.txt",
+                    TextFormat format = TextFormat::Fixed);
+
+  void consume(const TrajectoryChunk &chunk) override;
+  void flush() override;
+};
+
+// Accumula minimo, massimo, media e varianza di x, y e H senza conservare i
+// campioni
+class StatisticsSink : public TrajectorySink {
+public:
+  using Column = RunningStats;
+
+private:
+  Column sx, sy, sH;
+
+public:
+  void consume(const TrajectoryChunk &chunk) override;
+
+  const Column &getx() const;
+  const Column &gety() const;
+  const Column &getH() const;
+
+  // Scrive le statistiche su file, nello stesso formato di computeStatistics
+  void writeStatistics(const std::string &path = "Statistics.txt") const;
+};
+
+// Conserva un campione ogni stride, ad esempio per disegnare il grafico di una
+// simulazione troppo lunga per essere salvata per intero
+class DecimatingSink : public TrajectorySink {
+private:
+  std::size_t stride;
+  std::size_t seen = 0;
+  std::vector<double> t, x, y;
+
+public:
+  explicit DecimatingSink(std::size_t newStride);
+
+  void consume(const TrajectoryChunk &chunk) override;
+
+  const std::vector<double> &gett() const;
+  const std::vector<double> &getx() const;
+  const std::vector<double> &gety() const;
+};
+
+// Inoltra i blocchi a un altro sink su un thread separato, cosi' che la
+// scrittura su disco si sovrapponga all'integrazione. consume copia il blocco
+// in uno degli slot preallocati e ritorna subito; si blocca solo se tutti gli
+// slot sono ancora in attesa di essere scritti. flush attende che il thread
+// abbia svuotato la coda e poi chiama flush sul sink interno
+class AsyncSink : public TrajectorySink {
+private:
+  TrajectorySink &inner;
+  SpscRing<TrajectoryChunk> ring;
+  std::thread worker;
+
+  void drain();
+
+public:
+  explicit AsyncSink(TrajectorySink &target, std::size_t slots = 4);
+  ~AsyncSink() override;
+
+  AsyncSink(const AsyncSink &) = delete;
+  AsyncSink &operator=(const AsyncSink &) = delete;
+
+  void consume(const TrajectoryChunk &chunk) override;
+  void flush() override;
+};
+
+// Pubblica i blocchi per un consumatore su un altro thread, ad esempio una
+// finestra che disegna la simulazione mentre procede. consume copia il blocco
+// in uno slot della coda senza lock e attende solo se il consumatore e'
+// indietro di tutti gli slot; il consumatore non attende mai
+class LiveSink : public TrajectorySink {
+private:
+  SpscRing<TrajectoryChunk> ring;
+  std::atomic<bool> closed{false};
+  bool ended = false;
+
+public:
+  explicit LiveSink(std::size_t slots = 16);
+
+  LiveSink(const LiveSink &) = delete;
+  LiveSink &operator=(const LiveSink &) = delete;
+
+  void consume(const TrajectoryChunk &chunk) override;
+
+  // Produttore: segnala che non arriveranno altri blocchi
+  void finish();
+
+  // Consumatore: passa a receiver i blocchi gia' pubblicati, senza attendere.
+  // Restituisce false quando il produttore ha chiamato finish e tutti i
+  // blocchi sono stati ricevuti
+  template <class Receiver> bool poll(Receiver &&receiver) {
+    while (!ended) {
+      TrajectoryChunk *chunk = ring.tryFront();
+      if (chunk == nullptr)
+        return true;
+      // Un blocco vuoto segnala la fine
+      if (chunk->empty())
+        ended = true;
+      else
+        receiver(static_cast<const TrajectoryChunk &>(*chunk));
+      ring.pop();
+    }
+    return false;
+  }
+
+  // Consumatore: smette di ricevere (ad esempio quando la finestra viene
+  // chiusa prima della fine); i blocchi successivi vengono scartati e il
+  // produttore non resta mai in attesa
+  void close();
+};
+
+// Scrive su file l'esito del controllo di stabilita' di H (H iniziale, massima
+// deviazione relativa, tolleranza) e restituisce true se H e' stabile
+bool writeHStability(const std::string &path, double H0, double maxDeviation,
+                     double tolerance);
+
+// Scrive su file le statistiche (minimo, massimo, media, varianza) di x, y e
+// H; una grandezza senza campioni (ad esempio H non calcolato) viene omessa.
+// I valori non finiti di H sono esclusi dalle statistiche e indicati a parte
+void writeStatistics(const std::string &path, const RunningStats &x,
+                     const RunningStats &y, const RunningStats &H);
+
+} // namespace pf
+
+#endif // TRAJECTORY_SINK_HPP